@@ -19,23 +19,27 @@ void runBankersAlgorithm() {
     cin >> m;
     cin.ignore();
 
-    vector<vector<int>> allocation(n, vector<int>(m));
-    vector<vector<int>> maximum(n, vector<int>(m));
-    vector<vector<int>> need(n, vector<int>(m));
+    // Row-major n x m matrices, one allocation each: row i starts at i * m
+    vector<int> allocation(n * m);
+    vector<int> maximum(n * m);
+    vector<int> need(n * m);
     vector<int> available(m);
+    vector<int> row;
 
     cout << "\nEnter Allocation Matrix (0 1 0 OR 010):\n";
     for (int i = 0; i < n; i++) {
         cout << "P" << i << ": ";
         string line; getline(cin, line);
-        parseInput(line, allocation[i], m);
+        parseInput(line, row, m);
+        for (int j = 0; j < m && j < (int)row.size(); j++) allocation[i * m + j] = row[j];
     }
 
     cout << "\nEnter Maximum Matrix:\n";
     for (int i = 0; i < n; i++) {
         cout << "P" << i << ": ";
         string line; getline(cin, line);
-        parseInput(line, maximum[i], m);
+        parseInput(line, row, m);
+        for (int j = 0; j < m && j < (int)row.size(); j++) maximum[i * m + j] = row[j];
     }
 
     cout << "\nEnter Available Resources:\n";
@@ -45,7 +49,7 @@ void runBankersAlgorithm() {
     // Calculate Need Matrix
     for (int i = 0; i < n; i++)
         for (int j = 0; j < m; j++)
-            need[i][j] = maximum[i][j] - allocation[i][j];
+            need[i * m + j] = maximum[i * m + j] - allocation[i * m + j];
 
 
     vector<bool> finished(n, false);
@@ -63,16 +67,18 @@ void runBankersAlgorithm() {
 
         for (int i = 0; i < n; i++) {
             if (!finished[i]) {
+                const int* needRow = need.data() + i * m;
+                const int* allocRow = allocation.data() + i * m;
                 bool canRun = true;
                 for (int j = 0; j < m; j++) {
-                    if (need[i][j] > work[j]) {
+                    if (needRow[j] > work[j]) {
                         canRun = false;
                         break;
                     }
                 }
 
                 if (canRun) {
-                    for (int j = 0; j < m; j++) work[j] += allocation[i][j];
+                    for (int j = 0; j < m; j++) work[j] += allocRow[j];
                     finished[i] = true;
                     safeSeq.push_back(i);
                     completed++;
@@ -2,19 +2,20 @@
 #include <fstream>
 #include <queue>
 #include <unordered_map>
+#include <set>
+#include <climits>
 #include <algorithm>
 #include "memory.h"
 
 using namespace std;
 
-// Helper to check if page exists in frame
-bool inFrame(const vector<int>& frame, int page) {
-    return find(frame.begin(), frame.end(), page) != frame.end();
-}
-
-json runPageReplacement(const vector<Process>& processes, int ram_size, int frame_size, Algorithm algo) {
+json runPageReplacement(const vector<Process>& processes, int ram_size, int frame_size, Algorithm algo,
+                        int keyframe_every) {
     json output;
+    bool delta = keyframe_every > 0;    // steps carry slot changes, not frames
     vector<int> frame(frame_size, -1);
+    unordered_map<int, int> slot_of;          // resident page → frame index
+    int filled = 0;                           // frames fill left to right
     vector<json> steps;
     int page_faults = 0;
 
@@ -22,20 +23,51 @@ json runPageReplacement(const vector<Process>& processes, int ram_size, int fram
         queue<int> fifo_queue;                // ✅ STORES FRAME INDICES
         unordered_map<int, int> last_used;    // page → last used time
 
+        // OPTIMAL: next_use[i] is the next position of the same page in this
+        // process (INT_MAX if none), filled in one backward pass. Resident
+        // pages are ordered by (next use, -frame index), so the victim is the
+        // last entry: farthest next use, lowest frame index on ties.
+        vector<int> next_use;
+        set<pair<int, int>> by_next_use;
+        if (algo == Algorithm::OPTIMAL) {
+            const vector<int>& refs = proc.reference_string;
+            next_use.assign(refs.size(), INT_MAX);
+            unordered_map<int, int> upcoming;
+            for (int i = (int)refs.size() - 1; i >= 0; i--) {
+                auto it = upcoming.find(refs[i]);
+                if (it != upcoming.end()) next_use[i] = it->second;
+                upcoming[refs[i]] = i;
+            }
+            // Pages left resident by earlier processes
+            for (int j = 0; j < filled; j++) {
+                auto it = upcoming.find(frame[j]);
+                by_next_use.insert({ it != upcoming.end() ? it->second : INT_MAX, -j });
+            }
+        }
+
         for (int i = 0; i < proc.reference_string.size(); i++) {
             int ref = proc.reference_string[i];
             bool fault = false;
-
-            if (!inFrame(frame, ref)) {
+            int written = -1;                 // frame index loaded on a fault
+            int evicted = -1;                 // page it replaced, -1 if empty
+
+            auto resident = slot_of.find(ref);
+            if (resident != slot_of.end()) {
+                if (algo == Algorithm::OPTIMAL) {
+                    // This reference was the page's next use; advance it
+                    by_next_use.erase({ i, -resident->second });
+                    by_next_use.insert({ next_use[i], -resident->second });
+                }
+            }
+            else {
                 fault = true;
                 page_faults++;
 
                 int idx = -1;
 
                 // Empty frame available
-                auto it = find(frame.begin(), frame.end(), -1);
-                if (it != frame.end()) {
-                    idx = it - frame.begin();
+                if (filled < frame_size) {
+                    idx = filled;
                 }
                 else {
                     // Replacement needed
@@ -60,22 +92,10 @@ json runPageReplacement(const vector<Process>& processes, int ram_size, int fram
                         }
                     }
                     else if (algo == Algorithm::OPTIMAL) {
-                        int farthest = -1;
-                        for (int j = 0; j < frame_size; j++) {
-                            int page = frame[j];
-                            int next_use = INT_MAX;
-
-                            for (int k = i + 1; k < proc.reference_string.size(); k++) {
-                                if (proc.reference_string[k] == page) {
-                                    next_use = k;
-                                    break;
-                                }
-                            }
-
-                            if (next_use > farthest) {
-                                farthest = next_use;
-                                idx = j;
-                            }
+                        if (!by_next_use.empty()) {
+                            auto victim = prev(by_next_use.end());
+                            idx = -victim->second;
+                            by_next_use.erase(victim);
                         }
                     }
                 }
@@ -90,7 +110,16 @@ json runPageReplacement(const vector<Process>& processes, int ram_size, int fram
                     return output;
                 }
 
+                written = idx;
+                evicted = frame[idx];
+                if (frame[idx] == -1) filled++;
+                else slot_of.erase(frame[idx]);
                 frame[idx] = ref;
+                slot_of[ref] = idx;
+
+                if (algo == Algorithm::OPTIMAL) {
+                    by_next_use.insert({ next_use[i], -idx });
+                }
 
                 // Track FIFO correctly
                 if (algo == Algorithm::FIFO) {
@@ -105,7 +134,14 @@ json runPageReplacement(const vector<Process>& processes, int ram_size, int fram
             json step;
             step["process"] = proc.pid;
             step["reference"] = ref;
-            step["frames"] = frame;
+            // Delta steps repeat the whole frame list only every keyframe_every steps
+            if (!delta || steps.size() % keyframe_every == 0) {
+                step["frames"] = frame;
+            }
+            if (delta && written != -1) {
+                step["slot"] = written;
+                if (evicted != -1) step["evicted"] = evicted;
+            }
             step["page_fault"] = fault;
             steps.push_back(step);
         }
@@ -113,6 +149,11 @@ json runPageReplacement(const vector<Process>& processes, int ram_size, int fram
 
     output["steps"] = steps;
     output["total_page_faults"] = page_faults;
+    if (delta) {
+        output["trace_format"] = "delta";
+        output["frame_size"] = frame_size;
+        output["keyframe_every"] = keyframe_every;
+    }
     return output;
 }
 
@@ -136,6 +177,12 @@ void runPageReplacementFromFile() {
     int ram_size = input["ram_size"];
     int frame_size = input["frame_size"];
     string algo_str = input["algorithm"];
+    // Optional delta-encoded trace: "trace_format": "delta", "keyframe_every": K
+    int keyframe_every = 0;
+    if (input.value("trace_format", "") == "delta") {
+        keyframe_every = input.value("keyframe_every", 256);
+        if (keyframe_every < 1) keyframe_every = 1;
+    }
 
     Algorithm algo = Algorithm::FIFO;
     if (algo_str == "LRU") algo = Algorithm::LRU;
@@ -151,7 +198,7 @@ void runPageReplacementFromFile() {
         processes.push_back(proc);
     }
 
-    json output = runPageReplacement(processes, ram_size, frame_size, algo);
+    json output = runPageReplacement(processes, ram_size, frame_size, algo, keyframe_every);
 
     ofstream fout("output.json");
     fout << output.dump(4);
@@ -13,5 +13,9 @@ struct Process {
 enum class Algorithm { FIFO, LRU, OPTIMAL };
 
 // Function declarations only
-json runPageReplacement(const std::vector<Process>& processes, int ram_size, int frame_size, Algorithm algo);
+// keyframe_every > 0 selects the delta trace format: steps record the frame
+// index written ("slot") and the page it replaced ("evicted"), and the full
+// frame list only every keyframe_every steps.
+json runPageReplacement(const std::vector<Process>& processes, int ram_size, int frame_size, Algorithm algo,
+                        int keyframe_every = 0);
 void runPageReplacementFromFile();
@@ -87,6 +87,19 @@ def visualize_deadlock():
 
 
 # -------------------- MEMORY / PAGE REPLACEMENT --------------------
+def expand_delta_steps(output):
+    """Rebuild the full frame list of every step of a delta-encoded trace."""
+    frames = [-1] * output["frame_size"]
+    steps = []
+    for step in output["steps"]:
+        if "frames" in step:
+            frames = list(step["frames"])
+        elif "slot" in step:
+            frames[step["slot"]] = step["reference"]
+        steps.append(dict(step, frames=list(frames)))
+    return steps
+
+
 def visualize_memory():
     input_file = "visualizer/input.json"
     output_file = "visualizer/output.json"
@@ -102,6 +115,9 @@ def visualize_memory():
     with open(output_file) as f:
         output = json.load(f)
 
+    if output.get("trace_format") == "delta":
+        output["steps"] = expand_delta_steps(output)
+
     print("========== MEMORY / PAGE REPLACEMENT VISUALIZER ==========")
     for idx, step in enumerate(output["steps"]):
         pid = step["process"]
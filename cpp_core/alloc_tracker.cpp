@@ -0,0 +1,95 @@
+#include "alloc_tracker.h"
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Placed in front of every block so a free knows what it releases. Sizes
+// keep the low 56 bits, the subsystem the top 8.
+struct alignas(std::max_align_t) Header {
+  uint64_t size_and_subsystem;
+  uint64_t owner; // AllocationStats::owner at allocation time, or 0
+};
+
+void *allocate(size_t size) {
+  for (;;) {
+    if (void *p = std::malloc(sizeof(Header) + size)) {
+      Header *h = static_cast<Header *>(p);
+      AllocationStats *stats = AllocationStats::active();
+      AllocationStats::Subsystem subsystem = AllocationStats::current();
+      h->size_and_subsystem = (uint64_t)size | ((uint64_t)subsystem << 56);
+      h->owner = stats ? stats->owner : 0;
+      if (stats)
+        stats->charge(subsystem, size);
+      return h + 1;
+    }
+    std::new_handler handler = std::get_new_handler();
+    if (!handler)
+      throw std::bad_alloc();
+    handler();
+  }
+}
+
+void release(void *p) noexcept {
+  if (!p)
+    return;
+  Header *h = static_cast<Header *>(p) - 1;
+  AllocationStats *stats = AllocationStats::active();
+  if (stats && h->owner && h->owner == stats->owner)
+    stats->discharge(
+        (AllocationStats::Subsystem)(h->size_and_subsystem >> 56),
+        (size_t)(h->size_and_subsystem & ((uint64_t(1) << 56) - 1)));
+  std::free(h);
+}
+
+} // namespace
+
+long long AllocationStats::peakResidentBytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+    return (long long)counters.PeakWorkingSetSize;
+  return 0;
+#else
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+#ifdef __APPLE__
+  return (long long)usage.ru_maxrss; // bytes
+#else
+  return (long long)usage.ru_maxrss * 1024; // kilobytes
+#endif
+#endif
+}
+
+// Every form of the replaceable allocation functions goes through the pair
+// above, so no block can be freed by a function that misreads its header.
+// The over-aligned forms keep their own allocation and are not counted.
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  try {
+    return allocate(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, size_t) noexcept { release(p); }
+void operator delete[](void *p, size_t) noexcept { release(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { release(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  release(p);
+}
@@ -0,0 +1,101 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Heap use of one request, split by subsystem. The global operator new of
+// alloc_tracker.cpp charges every allocation made on a thread to the stats
+// active there, under the innermost Tag's subsystem, and remembers the owner
+// so that a later free on that thread lowers the live byte count again.
+// Programs built without alloc_tracker.cpp (the shared library, the bench)
+// keep their own operator new and simply leave these at zero.
+struct AllocationStats {
+  // In the order the report lists them
+  enum Subsystem {
+    BANKER,
+    DEADLOCK,
+    GENERATOR,
+    JSON,
+    MEMORY,
+    MRC,
+    OTHER,
+    SUBSYSTEMS
+  };
+
+  struct Usage {
+    long long allocations = 0;
+    long long bytes = 0;      // total requested
+    long long live_bytes = 0; // allocated and not yet freed
+    long long peak_bytes = 0; // highest live_bytes
+  };
+
+  Usage usage[SUBSYSTEMS];
+  Usage total;
+  uint64_t owner = 0; // tag stored with each allocation, set on first Scope
+
+  void charge(Subsystem subsystem, size_t size) {
+    add(usage[subsystem], (long long)size);
+    add(total, (long long)size);
+  }
+  void discharge(Subsystem subsystem, size_t size) {
+    usage[subsystem].live_bytes -= (long long)size;
+    total.live_bytes -= (long long)size;
+  }
+
+  // Stats of the request running on this thread, or null
+  static AllocationStats *&active() {
+    static thread_local AllocationStats *stats = nullptr;
+    return stats;
+  }
+  static Subsystem &current() {
+    static thread_local Subsystem subsystem = OTHER;
+    return subsystem;
+  }
+
+  // Highest resident set size of the whole process so far, in bytes, or 0
+  // where the platform cannot tell (defined in alloc_tracker.cpp)
+  static long long peakResidentBytes();
+
+  class Scope {
+    AllocationStats *saved;
+
+  public:
+    explicit Scope(AllocationStats *stats) : saved(active()) {
+      // Copies of a Metrics keep the owner, so frees made after the caller
+      // hands its stats on are still matched
+      static std::atomic<uint64_t> next_owner{1};
+      if (stats && !stats->owner)
+        stats->owner = next_owner.fetch_add(1, std::memory_order_relaxed);
+      active() = stats;
+    }
+    ~Scope() { active() = saved; }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+  // Charges allocations to `subsystem` until the end of the enclosing block
+  class Tag {
+    Subsystem saved;
+
+  public:
+    explicit Tag(Subsystem subsystem) : saved(current()) {
+      current() = subsystem;
+    }
+    ~Tag() { current() = saved; }
+    Tag(const Tag &) = delete;
+    Tag &operator=(const Tag &) = delete;
+  };
+
+private:
+  static void add(Usage &u, long long size) {
+    u.allocations++;
+    u.bytes += size;
+    u.live_bytes += size;
+    if (u.live_bytes > u.peak_bytes)
+      u.peak_bytes = u.live_bytes;
+  }
+};
+
+#endif
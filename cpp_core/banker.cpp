@@ -1,75 +1,337 @@
 #include "banker.h"
+#include "metrics.h"
+#include "thread_pool.h"
+#include "trace_events.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <mutex>
+
+namespace {
+
+int clampToCell(long long value, int cell_bytes) {
+    long long hi = cell_bytes == 1   ? INT8_MAX
+                   : cell_bytes == 2 ? INT16_MAX
+                                     : INT32_MAX;
+    return (int)std::min(std::max(value, -hi - 1), hi);
+}
+
+// Row i of an input matrix and how many of its first `cols` entries exist;
+// the rest read as 0
+const int* inputRow(const std::vector<std::vector<int>>& m, int i, int cols,
+                    int& count) {
+    count = i < (int)m.size() ? std::min(cols, (int)m[i].size()) : 0;
+    return count > 0 ? m[i].data() : nullptr;
+}
+
+// Fills both matrices with cells of type T, so the loop needs no per-cell
+// switch on the width
+template <typename T>
+void fillRows(PackedMatrix& allocation, PackedMatrix& need,
+              const std::vector<std::vector<int>>& max,
+              const std::vector<std::vector<int>>& alloc) {
+    for (int i = 0; i < need.rows(); i++) {
+        int max_count, alloc_count;
+        const int* max_row = inputRow(max, i, need.cols(), max_count);
+        const int* alloc_row = inputRow(alloc, i, need.cols(), alloc_count);
+        T* a = static_cast<T*>(allocation.row(i));
+        T* n = static_cast<T*>(need.row(i));
+        for (int j = 0; j < max_count; j++) n[j] = (T)max_row[j];
+        for (int j = 0; j < alloc_count; j++) {
+            a[j] = (T)alloc_row[j];
+            n[j] = (T)(n[j] - alloc_row[j]);
+        }
+    }
+}
+
+// Fewer rows than this per worker cost more to hand over than to check
+const int PARALLEL_MIN_ROWS = 4096;
+
+// Shared by every parallel check in the process, started on first use
+ThreadPool& checkPool() {
+    static ThreadPool pool(ThreadPool::defaultThreads());
+    return pool;
+}
+
+// Calls task(0) .. task(chunks - 1), all but the first on the pool, and
+// returns once every call has finished
+void runChunks(int chunks, const std::function<void(int)>& task) {
+    std::mutex mutex;
+    std::condition_variable finished;
+    int left = chunks - 1;
+    for (int c = 1; c < chunks; c++) {
+        checkPool().submit([&, c] {
+            task(c);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--left == 0) finished.notify_one();
+        });
+    }
+    task(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return left == 0; });
+}
+
+}
 
 BankerAlgorithm::BankerAlgorithm(int p, int r, const std::vector<int>& avail, 
                                const std::vector<std::vector<int>>& max,
-                               const std::vector<std::vector<int>>& alloc) 
-    : num_processes(p), num_resources(r), available(avail), maximum(max), allocation(alloc) {
-    
-    // Calculate Need Matrix
-    need.resize(num_processes, std::vector<int>(num_resources));
-    for (int i = 0; i < num_processes; i++) {
-        for (int j = 0; j < num_resources; j++) {
-            need[i][j] = maximum[i][j] - allocation[i][j];
+                               const std::vector<std::vector<int>>& alloc,
+                               const TraceOptions& trace) 
+    : num_processes(p), num_resources(r), available(avail), trace(trace) {
+    available.resize(num_resources);
+    // Narrow cells are only used when no count is negative. Then requests
+    // and releases keep every cell between the smallest need and the largest
+    // maximum, and work only grows, so a work cell that saturates still
+    // covers every need.
+    bool negative_allocation = false;
+    long long lo = 0, hi = 0;
+    for (int i = 0; i < num_processes && !negative_allocation; i++) {
+        int max_count, alloc_count;
+        const int* max_row = inputRow(max, i, num_resources, max_count);
+        const int* alloc_row = inputRow(alloc, i, num_resources, alloc_count);
+        for (int j = 0; j < std::max(max_count, alloc_count); j++) {
+            long long m = j < max_count ? max_row[j] : 0;
+            long long a = j < alloc_count ? alloc_row[j] : 0;
+            negative_allocation = negative_allocation || a < 0;
+            lo = std::min(lo, m - a);
+            hi = std::max(hi, std::max(m, a));
         }
     }
+    work_grows = !negative_allocation;
+    const bool narrow = work_grows &&
+                        std::all_of(available.begin(), available.end(),
+                                    [](int a) { return a >= 0; });
+    const int cell_bytes = narrow ? PackedMatrix::cellBytesFor(lo, hi) : 4;
+    allocation = PackedMatrix(p, r, cell_bytes);
+    need = PackedMatrix(p, r, cell_bytes);
+    kernels = &BankerKernels::best(cell_bytes);
+
+    // Calculate Need Matrix
+    if (cell_bytes == 1) fillRows<int8_t>(allocation, need, max, alloc);
+    else if (cell_bytes == 2) fillRows<int16_t>(allocation, need, max, alloc);
+    else fillRows<int32_t>(allocation, need, max, alloc);
+}
+
+void BankerAlgorithm::setIsa(BankerKernels::Isa isa) {
+    kernels = &BankerKernels::get(isa, need.cellBytes());
+}
+
+PackedMatrix BankerAlgorithm::initialWork() const {
+    PackedMatrix work(1, num_resources, need.cellBytes());
+    for (int j = 0; j < num_resources; j++)
+        work.set(0, j, clampToCell(available[j], need.cellBytes()));
+    return work;
+}
+
+bool BankerAlgorithm::safeSequence(std::vector<int>& sequence) const {
+    switch (strategy) {
+    // The queues only ever cover more needs, and a round runs everything
+    // that fit its starting work; both take a work vector that never
+    // shrinks, otherwise the scan is the reference
+    case QUEUE:
+        return work_grows ? queueSequence(sequence) : scanSequence(sequence);
+    case PARALLEL:
+        return work_grows ? parallelSequence(sequence) : scanSequence(sequence);
+    default: return scanSequence(sequence);
+    }
 }
 
-JsonValue BankerAlgorithm::solve() {
-    JsonValue result = JsonValue::object();
-    std::vector<int> work = available;
-    std::vector<bool> finish(num_processes, false);
-    std::vector<std::string> safe_seq;
-    JsonValue steps = JsonValue::array();
+bool BankerAlgorithm::scanSequence(std::vector<int>& sequence) const {
+    PackedMatrix work = initialWork();
+    const int bytes = need.rowBytes();
+    std::vector<unsigned char> finish(num_processes, 0);
+    sequence.clear();
+    sequence.reserve(num_processes);
 
     int completed = 0;
     bool made_progress = true;
+    long long rows_checked = 0;
 
     while (completed < num_processes && made_progress) {
         made_progress = false;
-        
-        for (int i = 0; i < num_processes; i++) {
-            if (!finish[i]) {
-                bool can_allocate = true;
-                for (int j = 0; j < num_resources; j++) {
-                    if (need[i][j] > work[j]) {
-                        can_allocate = false;
-                        break;
-                    }
-                }
-
-                if (can_allocate) {
-                    // Execute process
-                    JsonValue step = JsonValue::object();
-                    step["process"] = "P" + std::to_string(i);
-                    JsonValue work_arr = JsonValue::array();
-                    for(int w : work) work_arr.push_back(w);
-                    step["work_before"] = work_arr;
-                    
-                    // Release resources
-                    for (int j = 0; j < num_resources; j++) {
-                        work[j] += allocation[i][j];
-                    }
-                    
-                    JsonValue work_after = JsonValue::array();
-                    for(int w : work) work_after.push_back(w);
-                    step["work_after"] = work_after;
-                    
-                    steps.push_back(step);
-
-                    finish[i] = true;
-                    safe_seq.push_back("P" + std::to_string(i));
-                    completed++;
-                    made_progress = true;
-                }
+
+        // Each sweep runs every unfinished process that fits, in index order
+        int i = 0;
+        while ((i = kernels->find(need.row(0), bytes, i, num_processes,
+                                  finish.data(), work.row(0),
+                                  rows_checked)) < num_processes) {
+            // Execute process and release its resources
+            kernels->add(work.row(0), allocation.row(i), bytes);
+            finish[i] = 1;
+            sequence.push_back(i);
+            completed++;
+            made_progress = true;
+            i++;
+        }
+    }
+    if (EngineCounters* counters = EngineCounters::active())
+        counters->row_comparisons += rows_checked;
+    return completed == num_processes;
+}
+
+bool BankerAlgorithm::queueSequence(std::vector<int>& sequence) const {
+    const int n = num_processes;
+    const int m = num_resources;
+    std::vector<long long> work(available.begin(), available.end());
+    sequence.clear();
+    sequence.reserve(n);
+
+    // by_need[j] lists the processes by their need of resource j; the first
+    // covered[j] of them need no more than work[j]
+    std::vector<std::vector<int>> by_need(m, std::vector<int>(n));
+    std::vector<int> covered(m, 0);
+    std::vector<int> short_of(n, m); // resources with need above work
+
+    // Runnable processes, smallest index first. Those above the last one run
+    // are taken in the current sweep, the rest in the next, exactly as the
+    // scan would reach them.
+    std::vector<int> this_sweep, next_sweep;
+    int last = -1;
+    auto ready = [&](int i) {
+        std::vector<int>& heap = i > last ? this_sweep : next_sweep;
+        heap.push_back(i);
+        std::push_heap(heap.begin(), heap.end(), std::greater<int>());
+    };
+    auto cover = [&](int j) {
+        const std::vector<int>& order = by_need[j];
+        while (covered[j] < n && need.get(order[covered[j]], j) <= work[j]) {
+            int i = order[covered[j]++];
+            if (--short_of[i] == 0) ready(i);
+        }
+    };
+
+    if (m == 0) {
+        for (int i = 0; i < n; i++) ready(i);
+    }
+    for (int j = 0; j < m; j++) {
+        std::vector<int>& order = by_need[j];
+        for (int i = 0; i < n; i++) order[i] = i;
+        std::sort(order.begin(), order.end(),
+                  [&](int a, int b) {
+                      return need.get(a, j) < need.get(b, j);
+                  });
+        cover(j);
+    }
+
+    for (;;) {
+        if (this_sweep.empty()) {
+            if (next_sweep.empty()) break;
+            this_sweep.swap(next_sweep); // a new sweep from P0
+        }
+        std::pop_heap(this_sweep.begin(), this_sweep.end(),
+                      std::greater<int>());
+        int i = this_sweep.back();
+        this_sweep.pop_back();
+        last = i;
+        sequence.push_back(i);
+        // Only resources the process gives back can cover more needs
+        for (int j = 0; j < m; j++) {
+            int released = allocation.get(i, j);
+            if (released > 0) {
+                work[j] += released;
+                cover(j);
+            }
+        }
+    }
+    return (int)sequence.size() == n;
+}
+
+// Every process that fits the work at the start of a round can run in that
+// round, since work only grows as they finish (safeSequence() only comes
+// here when no allocation is negative), so the rounds reach the same set of
+// finished processes as the scan. The rows are split into one contiguous
+// chunk per worker; each round the workers only read `work` and `finish`,
+// and the caller then applies the runnable processes in index order, so the
+// sequence does not depend on the number of workers.
+bool BankerAlgorithm::parallelSequence(std::vector<int>& sequence) const {
+    const int n = num_processes;
+    const int bytes = need.rowBytes();
+    PackedMatrix work = initialWork();
+    std::vector<unsigned char> finish(n, 0);
+    sequence.clear();
+    sequence.reserve(n);
+
+    int chunks = std::max(1, n / PARALLEL_MIN_ROWS);
+    if (chunks > 1)
+        chunks = std::min(chunks, check_threads > 0
+                                      ? check_threads
+                                      : (int)checkPool().size());
+    std::vector<std::vector<int>> runnable(chunks);
+    std::vector<long long> rows_checked(chunks, 0);
+    auto check = [&](int c) {
+        const int from = (int)((long long)n * c / chunks);
+        const int to = (int)((long long)n * (c + 1) / chunks);
+        runnable[c].clear();
+        int i = from;
+        while ((i = kernels->find(need.row(0), bytes, i, to, finish.data(),
+                                  work.row(0), rows_checked[c])) < to)
+            runnable[c].push_back(i++);
+    };
+
+    bool made_progress = true;
+    while ((int)sequence.size() < n && made_progress) {
+        if (chunks == 1) check(0);
+        else runChunks(chunks, check);
+        made_progress = false;
+        for (const std::vector<int>& found : runnable) {
+            for (int i : found) {
+                kernels->add(work.row(0), allocation.row(i), bytes);
+                finish[i] = 1;
+                sequence.push_back(i);
+                made_progress = true;
             }
         }
     }
+    if (EngineCounters* counters = EngineCounters::active()) {
+        for (long long checked : rows_checked)
+            counters->row_comparisons += checked;
+    }
+    return (int)sequence.size() == n;
+}
+
+JsonValue BankerAlgorithm::solve() {
+    TraceSpan span("banker.solve", "banker");
+    JsonValue result = JsonValue::object();
+    std::vector<int> safe_seq;
+    bool safe = safeSequence(safe_seq);
+    adoptWitness(safe_seq, safe);
+
+    // Replay the finishing order to record how `work` grew at each step,
+    // exactly rather than saturated as in the check
+    JsonValue steps = JsonValue::array();
+    std::vector<long long> work(available.begin(), available.end());
+    for (size_t k = 0; trace.enabled() && k < safe_seq.size(); k++) {
+        int i = safe_seq[k];
+        // Every run changes state, so it is an event
+        bool record = trace.keep(k, true);
+        JsonValue step;
+        if (record) {
+            step = JsonValue::object();
+            if (trace.indexed()) step["index"] = (double)k;
+            step["process"] = "P" + std::to_string(i);
+            JsonValue work_arr = JsonValue::array();
+            for (int j = 0; j < num_resources; j++)
+                work_arr.push_back((double)work[j]);
+            step["work_before"] = work_arr;
+        }
+
+        for (int j = 0; j < num_resources; j++) work[j] += allocation.get(i, j);
+
+        if (record) {
+            JsonValue work_after = JsonValue::array();
+            for (int j = 0; j < num_resources; j++)
+                work_after.push_back((double)work[j]);
+            step["work_after"] = work_after;
+            steps.push_back(step);
+        }
+    }
 
-    if (completed == num_processes) {
+    if (safe) {
         result["safe"] = true;
         JsonValue seq_arr = JsonValue::array();
-        for(const auto& s : safe_seq) seq_arr.push_back(s);
+        for(int i : safe_seq) seq_arr.push_back("P" + std::to_string(i));
         result["safe_sequence"] = seq_arr;
     } else {
         result["safe"] = false;
@@ -79,3 +341,88 @@ JsonValue BankerAlgorithm::solve() {
     result["steps"] = steps;
     return result;
 }
+
+void BankerAlgorithm::adoptWitness(const std::vector<int>& sequence,
+                                   bool safe) {
+    witness_state = safe ? WITNESS_SAFE : WITNESS_UNSAFE;
+    if (!safe) return;
+    witness = sequence;
+    witness_position.assign(num_processes, 0);
+    for (int k = 0; k < num_processes; k++)
+        witness_position[witness[k]] = k;
+}
+
+// After `pid` was granted a request, every process up to `pid` in the old
+// sequence sees that much less work, while `pid` needs that much less and
+// later processes see the same work as before. So the old sequence is still
+// safe if the processes before `pid` can still run.
+bool BankerAlgorithm::witnessHolds(int pid) const {
+    if (witness_state != WITNESS_SAFE) return false;
+    PackedMatrix work = initialWork();
+    const int bytes = need.rowBytes();
+    const int end = witness_position[pid];
+    long long rows_checked = 0;
+    bool holds = true;
+    for (int k = 0; k < end && holds; k++) {
+        int i = witness[k];
+        rows_checked++;
+        holds = kernels->fits(need.row(i), work.row(0), bytes);
+        kernels->add(work.row(0), allocation.row(i), bytes);
+    }
+    if (EngineCounters* counters = EngineCounters::active())
+        counters->row_comparisons += rows_checked;
+    return holds;
+}
+
+// Moves `amounts` from the pool to `pid` (sign 1) or back (sign -1)
+void BankerAlgorithm::transfer(int pid, const std::vector<int>& amounts,
+                               int sign) {
+    for (int j = 0; j < num_resources; j++) {
+        available[j] -= sign * amounts[j];
+        allocation.set(pid, j, allocation.get(pid, j) + sign * amounts[j]);
+        need.set(pid, j, need.get(pid, j) - sign * amounts[j]);
+    }
+}
+
+BankerAlgorithm::RequestOutcome
+BankerAlgorithm::request(int pid, const std::vector<int>& amounts) {
+    last_full_check = false;
+    if (pid < 0 || pid >= num_processes || (int)amounts.size() != num_resources)
+        return INVALID;
+    for (int j = 0; j < num_resources; j++) {
+        if (amounts[j] < 0) return INVALID;
+    }
+    for (int j = 0; j < num_resources; j++) {
+        if (amounts[j] > need.get(pid, j)) return EXCEEDS_NEED;
+    }
+    for (int j = 0; j < num_resources; j++) {
+        if (amounts[j] > available[j]) return MUST_WAIT;
+    }
+
+    transfer(pid, amounts, 1);
+    if (witnessHolds(pid)) return GRANTED;
+
+    // The old order breaks before `pid`; another one may still exist
+    last_full_check = true;
+    std::vector<int> sequence;
+    if (safeSequence(sequence)) {
+        adoptWitness(sequence, true);
+        return GRANTED;
+    }
+    transfer(pid, amounts, -1);
+    return UNSAFE;
+}
+
+bool BankerAlgorithm::release(int pid, const std::vector<int>& amounts) {
+    if (pid < 0 || pid >= num_processes || (int)amounts.size() != num_resources)
+        return false;
+    for (int j = 0; j < num_resources; j++) {
+        if (amounts[j] < 0 || amounts[j] > allocation.get(pid, j)) return false;
+    }
+    transfer(pid, amounts, -1);
+    // Every process up to `pid` gains work and `pid` needs exactly what it
+    // gave back, so a safe sequence stays safe; an unsafe state may not be
+    // unsafe any more
+    if (witness_state == WITNESS_UNSAFE) witness_state = WITNESS_UNKNOWN;
+    return true;
+}
@@ -3,23 +3,101 @@
 
 #include <vector>
 #include <string>
+#include "banker_kernels.h"
 #include "json_utils.h"
+#include "matrix.h"
+#include "trace.h"
 
 class BankerAlgorithm {
 private:
     int num_processes;
     int num_resources;
     std::vector<int> available;
-    std::vector<std::vector<int>> maximum;
-    std::vector<std::vector<int>> allocation;
-    std::vector<std::vector<int>> need;
+    // One contiguous block each, rows padded for the vector kernels. Cells
+    // are 1 or 2 bytes when every count fits (see the constructor), else 4.
+    PackedMatrix allocation;
+    PackedMatrix need;
+    TraceOptions trace;
+    const BankerKernels* kernels;
+
+    // `available` as a row of the matrices, as the kernels expect. Cells
+    // above the widest value of the cell type are clamped to it.
+    PackedMatrix initialWork() const;
+
+public:
+    // How the safety check finds the next process to run. SCAN sweeps every
+    // unfinished process until a sweep makes no progress, O(n^2 m) in the
+    // worst case. QUEUE keeps each resource's needs sorted and counts, per
+    // process, the resources it is still short of, so each process is
+    // touched O(m log n) times. Both finish processes in the same order.
+    // PARALLEL checks every unfinished process against the same work in
+    // rounds, split across a thread pool, then runs all that fit in index
+    // order; the verdict is the same, the order can differ. QUEUE and
+    // PARALLEL need non-negative allocations; states with a negative one
+    // are scanned instead.
+    enum Strategy { SCAN, QUEUE, PARALLEL };
+
+private:
+    Strategy strategy = SCAN;
+    // No allocation was negative at load, so work only grows during a check;
+    // requests and releases keep it that way
+    bool work_grows = true;
+    int check_threads = 0;
+
+    bool scanSequence(std::vector<int>& sequence) const;
+    bool queueSequence(std::vector<int>& sequence) const;
+    bool parallelSequence(std::vector<int>& sequence) const;
+
+    // A safe sequence of the current state, kept between request() and
+    // release() calls so a request only re-checks the processes that finish
+    // before the requesting one
+    enum WitnessState { WITNESS_UNKNOWN, WITNESS_SAFE, WITNESS_UNSAFE };
+    WitnessState witness_state = WITNESS_UNKNOWN;
+    std::vector<int> witness;
+    std::vector<int> witness_position; // index of each process in `witness`
+    bool last_full_check = false;
+
+    void adoptWitness(const std::vector<int>& sequence, bool safe);
+    bool witnessHolds(int pid) const;
+    void transfer(int pid, const std::vector<int>& amounts, int sign);
 
 public:
     BankerAlgorithm(int p, int r, const std::vector<int>& avail, 
                    const std::vector<std::vector<int>>& max,
-                   const std::vector<std::vector<int>>& alloc);
+                   const std::vector<std::vector<int>>& alloc,
+                   const TraceOptions& trace = TraceOptions());
+
+    void setStrategy(Strategy s) { strategy = s; }
+    // Parts the PARALLEL check splits the processes into; 0 for one per core
+    void setThreads(int threads) { check_threads = threads; }
+    // Kernels for the row checks; the widest the CPU supports by default
+    void setIsa(BankerKernels::Isa isa);
+    // Bytes per matrix cell picked for the input: 1, 2 or 4
+    int cellBytes() const { return need.cellBytes(); }
 
     JsonValue solve();
+    // Runs the safety algorithm without building any JSON: `sequence` gets
+    // the processes in the order they could finish (a prefix if unsafe).
+    bool safeSequence(std::vector<int>& sequence) const;
+
+    enum RequestOutcome {
+        GRANTED,      // allocated, and the state is still safe
+        EXCEEDS_NEED, // more than the process declared it could still need
+        MUST_WAIT,    // more than is available right now
+        UNSAFE,       // granting it would leave no safe sequence
+        INVALID       // unknown process, wrong length or negative amounts
+    };
+
+    // Grants `amounts` to process `pid` if the result is safe; otherwise the
+    // state is left as it was
+    RequestOutcome request(int pid, const std::vector<int>& amounts);
+    // Returns `amounts` held by `pid` to the pool; false, with nothing
+    // changed, if the process holds less
+    bool release(int pid, const std::vector<int>& amounts);
+    // Whether the last request() needed a full safety check because the
+    // previous safe sequence did not carry over
+    bool lastCheckWasFull() const { return last_full_check; }
+    const std::vector<int>& availableNow() const { return available; }
 };
 
 #endif
@@ -0,0 +1,256 @@
+#include "banker_kernels.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__SSE2__) || defined(_M_X64) ||           \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BANKER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BANKER_AVX2 // MSVC compiles AVX2 intrinsics without a flag
+#else
+#define BANKER_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+
+template <typename T>
+bool fitsScalar(const void *need, const void *work, int bytes) {
+  const T *n = static_cast<const T *>(need);
+  const T *w = static_cast<const T *>(work);
+  for (int j = 0; j < bytes / (int)sizeof(T); j++) {
+    if (n[j] > w[j])
+      return false;
+  }
+  return true;
+}
+
+template <typename T>
+void addScalar(void *work, const void *allocation, int bytes) {
+  T *w = static_cast<T *>(work);
+  const T *a = static_cast<const T *>(allocation);
+  for (int j = 0; j < bytes / (int)sizeof(T); j++) {
+    long long sum = (long long)w[j] + a[j];
+    sum = std::min<long long>(sum, std::numeric_limits<T>::max());
+    sum = std::max<long long>(sum, std::numeric_limits<T>::min());
+    w[j] = (T)sum;
+  }
+}
+
+// The row loop lives in each version so the row test inlines into it
+template <typename T>
+int findScalar(const void *need, int bytes, int from, int to,
+               const unsigned char *finished, const void *work,
+               long long &checked) {
+  const unsigned char *rows = static_cast<const unsigned char *>(need);
+  for (int i = from; i < to; i++) {
+    if (finished[i])
+      continue;
+    checked++;
+    if (fitsScalar<T>(rows + (size_t)i * bytes, work, bytes))
+      return i;
+  }
+  return to;
+}
+
+#ifdef BANKER_X86
+// Compare and saturating add for each cell width. 32-bit lanes have no
+// saturating add: a sum overflowed if its sign differs from both operands',
+// and is then clamped toward the sign of the allocation.
+struct Sse2Int8 {
+  static __m128i greater(__m128i a, __m128i b) { return _mm_cmpgt_epi8(a, b); }
+  static __m128i add(__m128i a, __m128i b) { return _mm_adds_epi8(a, b); }
+};
+struct Sse2Int16 {
+  static __m128i greater(__m128i a, __m128i b) {
+    return _mm_cmpgt_epi16(a, b);
+  }
+  static __m128i add(__m128i a, __m128i b) { return _mm_adds_epi16(a, b); }
+};
+struct Sse2Int32 {
+  static __m128i greater(__m128i a, __m128i b) {
+    return _mm_cmpgt_epi32(a, b);
+  }
+  static __m128i add(__m128i a, __m128i b) {
+    __m128i sum = _mm_add_epi32(a, b);
+    __m128i over = _mm_srai_epi32(
+        _mm_and_si128(_mm_xor_si128(a, sum), _mm_xor_si128(b, sum)), 31);
+    __m128i limit =
+        _mm_xor_si128(_mm_set1_epi32(INT32_MAX), _mm_srai_epi32(b, 31));
+    return _mm_or_si128(_mm_and_si128(over, limit),
+                        _mm_andnot_si128(over, sum));
+  }
+};
+
+template <typename Ops>
+bool fitsSse2(const void *need, const void *work, int bytes) {
+  const char *n = static_cast<const char *>(need);
+  const char *w = static_cast<const char *>(work);
+  for (int k = 0; k < bytes; k += 16) {
+    __m128i over = Ops::greater(_mm_loadu_si128((const __m128i *)(n + k)),
+                                _mm_loadu_si128((const __m128i *)(w + k)));
+    if (_mm_movemask_epi8(over))
+      return false;
+  }
+  return true;
+}
+
+template <typename Ops>
+void addSse2(void *work, const void *allocation, int bytes) {
+  char *w = static_cast<char *>(work);
+  const char *a = static_cast<const char *>(allocation);
+  for (int k = 0; k < bytes; k += 16) {
+    __m128i sum = Ops::add(_mm_loadu_si128((const __m128i *)(w + k)),
+                           _mm_loadu_si128((const __m128i *)(a + k)));
+    _mm_storeu_si128((__m128i *)(w + k), sum);
+  }
+}
+
+template <typename Ops>
+int findSse2(const void *need, int bytes, int from, int to,
+             const unsigned char *finished, const void *work,
+             long long &checked) {
+  const unsigned char *rows = static_cast<const unsigned char *>(need);
+  for (int i = from; i < to; i++) {
+    if (finished[i])
+      continue;
+    checked++;
+    if (fitsSse2<Ops>(rows + (size_t)i * bytes, work, bytes))
+      return i;
+  }
+  return to;
+}
+
+struct Avx2Int8 {
+  BANKER_AVX2 static __m256i greater(__m256i a, __m256i b) {
+    return _mm256_cmpgt_epi8(a, b);
+  }
+  BANKER_AVX2 static __m256i add(__m256i a, __m256i b) {
+    return _mm256_adds_epi8(a, b);
+  }
+};
+struct Avx2Int16 {
+  BANKER_AVX2 static __m256i greater(__m256i a, __m256i b) {
+    return _mm256_cmpgt_epi16(a, b);
+  }
+  BANKER_AVX2 static __m256i add(__m256i a, __m256i b) {
+    return _mm256_adds_epi16(a, b);
+  }
+};
+struct Avx2Int32 {
+  BANKER_AVX2 static __m256i greater(__m256i a, __m256i b) {
+    return _mm256_cmpgt_epi32(a, b);
+  }
+  BANKER_AVX2 static __m256i add(__m256i a, __m256i b) {
+    __m256i sum = _mm256_add_epi32(a, b);
+    __m256i over = _mm256_srai_epi32(
+        _mm256_and_si256(_mm256_xor_si256(a, sum), _mm256_xor_si256(b, sum)),
+        31);
+    __m256i limit = _mm256_xor_si256(_mm256_set1_epi32(INT32_MAX),
+                                     _mm256_srai_epi32(b, 31));
+    return _mm256_blendv_epi8(sum, limit, over);
+  }
+};
+
+template <typename Ops>
+BANKER_AVX2 bool fitsAvx2(const void *need, const void *work, int bytes) {
+  const char *n = static_cast<const char *>(need);
+  const char *w = static_cast<const char *>(work);
+  for (int k = 0; k < bytes; k += 32) {
+    __m256i over = Ops::greater(_mm256_loadu_si256((const __m256i *)(n + k)),
+                                _mm256_loadu_si256((const __m256i *)(w + k)));
+    if (!_mm256_testz_si256(over, over))
+      return false;
+  }
+  return true;
+}
+
+template <typename Ops>
+BANKER_AVX2 void addAvx2(void *work, const void *allocation, int bytes) {
+  char *w = static_cast<char *>(work);
+  const char *a = static_cast<const char *>(allocation);
+  for (int k = 0; k < bytes; k += 32) {
+    __m256i sum = Ops::add(_mm256_loadu_si256((const __m256i *)(w + k)),
+                           _mm256_loadu_si256((const __m256i *)(a + k)));
+    _mm256_storeu_si256((__m256i *)(w + k), sum);
+  }
+}
+
+template <typename Ops>
+BANKER_AVX2 int findAvx2(const void *need, int bytes, int from, int to,
+                         const unsigned char *finished, const void *work,
+                         long long &checked) {
+  const unsigned char *rows = static_cast<const unsigned char *>(need);
+  for (int i = from; i < to; i++) {
+    if (finished[i])
+      continue;
+    checked++;
+    if (fitsAvx2<Ops>(rows + (size_t)i * bytes, work, bytes))
+      return i;
+  }
+  return to;
+}
+
+bool cpuHasAvx2() {
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  if (info[0] < 7)
+    return false;
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  bool avx = (info[2] & (1 << 28)) != 0;
+  // The OS must save the upper halves of the vector registers
+  if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+    return false;
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+#endif
+
+// Each table holds the 1, 2 and 4 byte versions, in that order
+const BankerKernels SCALAR_KERNELS[] = {
+    {fitsScalar<int8_t>, addScalar<int8_t>, findScalar<int8_t>, "scalar"},
+    {fitsScalar<int16_t>, addScalar<int16_t>, findScalar<int16_t>, "scalar"},
+    {fitsScalar<int32_t>, addScalar<int32_t>, findScalar<int32_t>, "scalar"}};
+#ifdef BANKER_X86
+const BankerKernels SSE2_KERNELS[] = {
+    {fitsSse2<Sse2Int8>, addSse2<Sse2Int8>, findSse2<Sse2Int8>, "sse2"},
+    {fitsSse2<Sse2Int16>, addSse2<Sse2Int16>, findSse2<Sse2Int16>, "sse2"},
+    {fitsSse2<Sse2Int32>, addSse2<Sse2Int32>, findSse2<Sse2Int32>, "sse2"}};
+const BankerKernels AVX2_KERNELS[] = {
+    {fitsAvx2<Avx2Int8>, addAvx2<Avx2Int8>, findAvx2<Avx2Int8>, "avx2"},
+    {fitsAvx2<Avx2Int16>, addAvx2<Avx2Int16>, findAvx2<Avx2Int16>, "avx2"},
+    {fitsAvx2<Avx2Int32>, addAvx2<Avx2Int32>, findAvx2<Avx2Int32>, "avx2"}};
+#endif
+
+int widthIndex(int cell_bytes) {
+  return cell_bytes == 1 ? 0 : cell_bytes == 2 ? 1 : 2;
+}
+
+} // namespace
+
+const BankerKernels &BankerKernels::get(Isa isa, int cell_bytes) {
+  const int w = widthIndex(cell_bytes);
+#ifdef BANKER_X86
+  static const bool avx2 = cpuHasAvx2();
+  if (isa == AVX2 && avx2)
+    return AVX2_KERNELS[w];
+  if (isa != SCALAR)
+    return SSE2_KERNELS[w]; // part of every x86-64 CPU
+#else
+  (void)isa;
+#endif
+  return SCALAR_KERNELS[w];
+}
+
+const BankerKernels &BankerKernels::best(int cell_bytes) {
+  return get(AVX2, cell_bytes);
+}
@@ -0,0 +1,32 @@
+#ifndef BANKER_KERNELS_H
+#define BANKER_KERNELS_H
+
+// Inner loops of the Banker safety check over padded PackedMatrix rows, in
+// scalar, SSE2 and AVX2 versions for each cell width. `bytes` is a row
+// length, so always a multiple of PackedMatrix::ROW_BYTES, and the padding
+// of both operands is zero. Work cells saturate at the largest value of the
+// cell type instead of wrapping; as no need is larger, a saturated work cell
+// still compares correctly.
+struct BankerKernels {
+  enum Isa { SCALAR, SSE2, AVX2 };
+
+  // Whether need[j] <= work[j] for every j
+  bool (*fits)(const void *need, const void *work, int bytes);
+  // work[j] += allocation[j], saturating
+  void (*add)(void *work, const void *allocation, int bytes);
+  // First row i in [from, to) of the `bytes`-long rows at `need` with
+  // !finished[i] that fits `work`, or `to`; adds the unfinished rows it
+  // looked at to `checked`
+  int (*find)(const void *need, int bytes, int from, int to,
+              const unsigned char *finished, const void *work,
+              long long &checked);
+  const char *name;
+
+  // The widest version this CPU runs for `cell_bytes` (1, 2 or 4) cells,
+  // picked once at first use
+  static const BankerKernels &best(int cell_bytes);
+  // A given version; falls back to narrower ones the CPU lacks
+  static const BankerKernels &get(Isa isa, int cell_bytes);
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "batch.h"
+#include "engine.h"
+#include "json_utils.h"
+#include "server.h"
+#include "thread_pool.h"
+#include "trace_events.h"
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Results waiting to be written in input order. Slot i % capacity holds job
+// i; at most `capacity` jobs are in flight, which bounds memory.
+struct ReorderWindow {
+  struct Slot {
+    std::string output;
+    bool done = false;
+  };
+  std::vector<Slot> slots;
+  std::mutex mutex;
+  std::condition_variable changed;
+
+  explicit ReorderWindow(size_t capacity) : slots(capacity) {}
+};
+
+void runJob(size_t index, const std::string &line, Metrics timing,
+            ResultCache *cache, std::string &output) {
+  // Each worker parses and builds into its own arena, reset after every job
+  static thread_local JsonArena arena;
+  static thread_local JsonParser parser;
+  JsonArena::Scope arena_scope(arena);
+
+  TraceEvents::nameThread("batch worker");
+  TraceSpan job_span("job", "batch", "index", (long long)index);
+  JsonWriter writer(output, -1);
+  JsonValue input; // kept for the job's id if the run fails
+  bool failed = false;
+  std::string failure;
+  try {
+    AllocationStats::Scope allocation_scope(&timing.allocations);
+    Metrics::Clock::time_point t = Metrics::Clock::now();
+    {
+      TraceSpan parse_span("parse", "json");
+      AllocationStats::Tag alloc_tag(AllocationStats::JSON);
+      input = parser.parse(line);
+    }
+    timing.lap(Metrics::PARSE, t);
+    writer.beginObject();
+    writer.key("id");
+    if (input["id"].type != JsonValue::NULL_VAL)
+      writer.value(input["id"]);
+    else
+      writer.value((long long)index);
+    writer.key("result");
+    runRequest(input, writer, &timing, cache);
+    writer.endObject();
+  } catch (const std::exception &e) {
+    failed = true;
+    failure = e.what();
+  } catch (...) {
+    failed = true;
+    failure = "Unknown error while running job";
+  }
+  writer.flush();
+  if (failed) {
+    output.clear();
+    JsonValue error = JsonValue::object();
+    const JsonValue &id = static_cast<const JsonValue &>(input)["id"];
+    if (id.type != JsonValue::NULL_VAL)
+      error["id"] = id;
+    else
+      error["id"] = (double)index;
+    error["error"] = failure;
+    JsonWriter(output, -1).value(error);
+  }
+  arena.reset();
+}
+
+} // namespace
+
+int runBatch(const std::string &jobs_file, const std::string &results_file,
+             size_t threads, ResultCache *cache) {
+  std::FILE *in = std::fopen(jobs_file.c_str(), "r");
+  if (!in) {
+    std::cerr << "Error: cannot open jobs file " << jobs_file << std::endl;
+    return 1;
+  }
+  std::FILE *out = std::fopen(results_file.c_str(), "w");
+  if (!out) {
+    std::cerr << "Error: cannot open results file " << results_file
+              << std::endl;
+    std::fclose(in);
+    return 1;
+  }
+
+  ReorderWindow window(4 * (threads > 0 ? threads : 1));
+  const size_t capacity = window.slots.size();
+  size_t submitted = 0;
+  size_t emitted = 0;
+
+  // Writes finished results at the head of the window; with `wait`, blocks
+  // until at least one is available
+  auto emitReady = [&](bool wait) {
+    std::unique_lock<std::mutex> lock(window.mutex);
+    if (wait)
+      window.changed.wait(
+          lock, [&] { return window.slots[emitted % capacity].done; });
+    while (emitted < submitted && window.slots[emitted % capacity].done) {
+      ReorderWindow::Slot &slot = window.slots[emitted % capacity];
+      std::string output;
+      output.swap(slot.output);
+      slot.done = false;
+      emitted++;
+      lock.unlock();
+      output.push_back('\n');
+      std::fwrite(output.data(), 1, output.size(), out);
+      lock.lock();
+    }
+  };
+
+  {
+    ThreadPool pool(threads);
+    std::string line;
+    for (;;) {
+      Metrics timing;
+      Metrics::Clock::time_point t = Metrics::Clock::now();
+      if (!readLine(in, line))
+        break;
+      timing.lap(Metrics::READ, t);
+      timing.bytes_read = line.size();
+      if (line.find_first_not_of(" \t") == std::string::npos)
+        continue;
+      if (submitted - emitted == capacity)
+        emitReady(true);
+      size_t index = submitted++;
+      pool.submit([&window, capacity, index, line, timing, cache] {
+        std::string output;
+        runJob(index, line, timing, cache, output);
+        {
+          std::lock_guard<std::mutex> lock(window.mutex);
+          window.slots[index % capacity].output.swap(output);
+          window.slots[index % capacity].done = true;
+        }
+        window.changed.notify_all();
+      });
+      emitReady(false);
+    }
+    while (emitted < submitted)
+      emitReady(true);
+  }
+
+  std::fclose(in);
+  std::fclose(out);
+  return 0;
+}
@@ -0,0 +1,15 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+
+class ResultCache;
+
+// Runs every job in `jobs_file` (one JSON input document per line) on a pool
+// of `threads` workers and writes one line per job to `results_file`, in
+// input order: {"id": <job "id", or its line index>, "result": {...}}.
+// Jobs repeating an earlier input are answered from `cache`, if given.
+int runBatch(const std::string &jobs_file, const std::string &results_file,
+             size_t threads, ResultCache *cache = nullptr);
+
+#endif
@@ -0,0 +1,357 @@
+// Benchmark driver for the simulation engines and the JSON layer.
+//
+//   bench [--quick] [--filter <substring>] [--out <results.json>]
+//
+// Every case runs over a few input sizes. A human-readable table goes to
+// stderr and the machine-readable results (ns/op, items/s, allocations/op)
+// to stdout or the --out file, so runs can be compared between releases.
+
+#include "banker.h"
+#include "deadlock.h"
+#include "json_utils.h"
+#include "memory.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+// Every global allocation is counted so each case can report allocs/op
+static std::atomic<size_t> g_allocations{0};
+static std::atomic<size_t> g_allocated_bytes{0};
+
+// Out of line so the compiler does not pair malloc/free across the
+// replaced operators
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+static void release(void *p) noexcept { std::free(p); }
+
+void *operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, size_t) noexcept { release(p); }
+void operator delete[](void *p, size_t) noexcept { release(p); }
+
+namespace {
+
+// Small fixed-seed generator so every run measures the same inputs
+struct SplitMix64 {
+  uint64_t state;
+  explicit SplitMix64(uint64_t seed) : state(seed) {}
+  uint64_t next() {
+    uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+  int below(int n) { return (int)(next() % (uint64_t)n); }
+};
+
+struct Result {
+  std::string name;
+  size_t size;
+  size_t iterations;
+  double ns_per_op;
+  double items_per_second;
+  double allocs_per_op;
+  double bytes_per_op;
+};
+
+struct Config {
+  double min_seconds = 0.25;
+  std::string filter;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Times `op` (which processes `items` items per call) until at least
+// `min_seconds` have passed. The arena is reset after every call so JSON
+// built by one iteration is not carried into the next.
+Result measure(const Config &config, const std::string &name, size_t size,
+               size_t items, const std::function<void()> &op) {
+  JsonArena arena;
+  JsonArena::Scope arena_scope(arena);
+  op(); // warm-up: page in inputs, size the arena
+  arena.reset();
+
+  size_t iterations = 0;
+  size_t allocs_before = g_allocations.load();
+  size_t bytes_before = g_allocated_bytes.load();
+  Clock::time_point start = Clock::now();
+  double elapsed = 0;
+  do {
+    op();
+    arena.reset();
+    iterations++;
+    elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  } while (elapsed < config.min_seconds);
+
+  Result r;
+  r.name = name;
+  r.size = size;
+  r.iterations = iterations;
+  r.ns_per_op = elapsed * 1e9 / iterations;
+  r.items_per_second = (double)items * iterations / elapsed;
+  r.allocs_per_op = (double)(g_allocations.load() - allocs_before) / iterations;
+  r.bytes_per_op =
+      (double)(g_allocated_bytes.load() - bytes_before) / iterations;
+  return r;
+}
+
+std::vector<int> referenceString(size_t n, int pages, uint64_t seed) {
+  // Mostly local references with occasional jumps, so every algorithm sees
+  // a mix of hits and evictions
+  SplitMix64 rng(seed);
+  std::vector<int> refs(n);
+  int base = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (rng.below(16) == 0)
+      base = rng.below(pages);
+    refs[i] = (base + rng.below(8)) % pages;
+  }
+  return refs;
+}
+
+// A safe state: every process can finish once all higher-numbered ones have
+struct BankerInput {
+  int processes, resources;
+  std::vector<int> available;
+  std::vector<std::vector<int>> max, alloc;
+};
+
+BankerInput bankerInput(int p, int r, uint64_t seed) {
+  SplitMix64 rng(seed);
+  BankerInput in{p, r, std::vector<int>(r), {}, {}};
+  for (int j = 0; j < r; j++)
+    in.available[j] = 1 + rng.below(4);
+  // Processes in reverse index order need at most what the ones after them
+  // release, so the scan finds one process per pass in the worst case
+  std::vector<int> work = in.available;
+  in.max.assign(p, std::vector<int>(r));
+  in.alloc.assign(p, std::vector<int>(r));
+  for (int i = p - 1; i >= 0; i--) {
+    for (int j = 0; j < r; j++) {
+      int need = rng.below(work[j] + 1);
+      in.alloc[i][j] = rng.below(4);
+      in.max[i][j] = in.alloc[i][j] + need;
+    }
+    for (int j = 0; j < r; j++)
+      work[j] += in.alloc[i][j];
+  }
+  return in;
+}
+
+std::vector<std::pair<std::string, std::string>> graphEdges(int nodes,
+                                                            uint64_t seed) {
+  // Acyclic (edges only go to higher ids), so detection visits every node
+  SplitMix64 rng(seed);
+  std::vector<std::pair<std::string, std::string>> edges;
+  for (int u = 0; u + 1 < nodes; u++) {
+    int fanout = 1 + rng.below(3);
+    for (int k = 0; k < fanout; k++) {
+      int v = u + 1 + rng.below(std::min(nodes - u - 1, 16));
+      edges.emplace_back((u % 2 ? "R" : "P") + std::to_string(u),
+                         (v % 2 ? "R" : "P") + std::to_string(v));
+    }
+  }
+  return edges;
+}
+
+std::string memoryDocument(const std::vector<int> &refs) {
+  std::string doc;
+  JsonWriter w(doc, -1);
+  w.beginObject();
+  w.key("memory");
+  w.beginObject();
+  w.key("algorithm");
+  w.value("LRU");
+  w.key("frames");
+  w.value(64);
+  w.key("references");
+  w.beginArray();
+  for (int page : refs)
+    w.value(page);
+  w.endArray();
+  w.endObject();
+  w.key("mode");
+  w.value("MEMORY");
+  w.endObject();
+  w.flush();
+  return doc;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Config config;
+  std::string out_file;
+  bool quick = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--quick") {
+      quick = true;
+      config.min_seconds = 0.02;
+    } else if (arg == "--filter" && i + 1 < argc) {
+      config.filter = argv[++i];
+    } else if (arg == "--out" && i + 1 < argc) {
+      out_file = argv[++i];
+    } else {
+      std::fprintf(stderr,
+                   "Usage: %s [--quick] [--filter <substring>] [--out <file>]\n",
+                   argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<Result> results;
+  auto run = [&](const std::string &name, size_t size, size_t items,
+                 const std::function<void()> &op) {
+    if (!config.filter.empty() && name.find(config.filter) == std::string::npos)
+      return;
+    results.push_back(measure(config, name, size, items, op));
+    const Result &r = results.back();
+    std::fprintf(stderr, "%-22s %9zu %14.0f ns/op %14.0f items/s %10.1f allocs/op\n",
+                 r.name.c_str(), r.size, r.ns_per_op, r.items_per_second,
+                 r.allocs_per_op);
+  };
+
+  std::vector<size_t> ref_sizes = {1000, 100000, 1000000};
+  std::vector<int> process_counts = {16, 256, 1024, 16384};
+  std::vector<int> node_counts = {100, 10000, 100000};
+  if (quick) {
+    ref_sizes = {1000, 100000};
+    process_counts = {16, 256};
+    node_counts = {100, 10000};
+  }
+
+  // Page replacement with no step trace: the algorithms themselves
+  TraceOptions no_trace;
+  no_trace.level = TraceOptions::NONE;
+  for (const char *algo : {"FIFO", "LRU", "OPTIMAL"}) {
+    for (size_t n : ref_sizes) {
+      std::vector<int> refs = referenceString(n, 1024, n);
+      run(std::string("memory/") + algo, n, n, [&] {
+        MemoryManager mgr(64, refs, algo, no_trace);
+        mgr.simulate();
+      });
+    }
+  }
+
+  // Page numbers sharing their low bits (a 64K stride), with every page
+  // resident: the page table must not pile them into one probe chain
+  for (size_t n : ref_sizes) {
+    std::vector<int> refs = referenceString(n, 1024, n);
+    for (int &page : refs)
+      page *= 65536;
+    run("memory/LRU-strided", n, n, [&] {
+      MemoryManager mgr(1024, refs, "LRU", no_trace);
+      mgr.simulate();
+    });
+  }
+
+  // Page replacement with the full trace built as JSON
+  for (size_t n : ref_sizes) {
+    std::vector<int> refs = referenceString(n, 1024, n);
+    run("memory/LRU+trace", n, n, [&] {
+      MemoryManager mgr(64, refs, "LRU");
+      mgr.simulate();
+    });
+  }
+
+  for (int p : process_counts) {
+    BankerInput in = bankerInput(p, 8, p);
+    run("banker/solve", p, p, [&] {
+      BankerAlgorithm banker(in.processes, in.resources, in.available, in.max,
+                             in.alloc, no_trace);
+      banker.solve();
+    });
+    run("banker/solve-queue", p, p, [&] {
+      BankerAlgorithm banker(in.processes, in.resources, in.available, in.max,
+                             in.alloc, no_trace);
+      banker.setStrategy(BankerAlgorithm::QUEUE);
+      banker.solve();
+    });
+    run("banker/solve-parallel", p, p, [&] {
+      BankerAlgorithm banker(in.processes, in.resources, in.available, in.max,
+                             in.alloc, no_trace);
+      banker.setStrategy(BankerAlgorithm::PARALLEL);
+      banker.solve();
+    });
+  }
+
+  for (int nodes : node_counts) {
+    auto edges = graphEdges(nodes, nodes);
+    run("deadlock/detect", nodes, edges.size(), [&] {
+      DeadlockDetector detector;
+      for (const auto &e : edges)
+        detector.addEdge(e.first, e.second);
+      detector.detect();
+    });
+  }
+
+  for (size_t n : ref_sizes) {
+    std::string doc = memoryDocument(referenceString(n, 1024, n));
+    JsonParser parser;
+    run("json/parse", n, doc.size(), [&] { parser.parse(doc); });
+
+    JsonValue parsed = JsonParser().parse(doc);
+    std::string text;
+    run("json/dump", n, doc.size(), [&] {
+      text.clear();
+      JsonWriter w(text, 4);
+      w.value(parsed);
+      w.flush();
+    });
+  }
+
+  // Machine-readable results; items are references, processes, edges or
+  // document bytes depending on the case
+  std::FILE *out = stdout;
+  if (!out_file.empty() && !(out = std::fopen(out_file.c_str(), "w"))) {
+    std::fprintf(stderr, "Error: cannot open output file %s\n",
+                 out_file.c_str());
+    return 1;
+  }
+  JsonWriter w(out, 4);
+  w.beginObject();
+  w.key("benchmarks");
+  w.beginArray();
+  for (const Result &r : results) {
+    w.beginObject();
+    w.key("allocs_per_op");
+    w.value(r.allocs_per_op);
+    w.key("bytes_per_op");
+    w.value(r.bytes_per_op);
+    w.key("items_per_second");
+    w.value(r.items_per_second);
+    w.key("iterations");
+    w.value((long long)r.iterations);
+    w.key("name");
+    w.value(r.name);
+    w.key("ns_per_op");
+    w.value(r.ns_per_op);
+    w.key("size");
+    w.value((long long)r.size);
+    w.endObject();
+  }
+  w.endArray();
+  w.key("min_time_seconds");
+  w.value(config.min_seconds);
+  w.endObject();
+  w.endLine();
+  if (out != stdout)
+    std::fclose(out);
+  return 0;
+}
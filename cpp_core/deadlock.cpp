@@ -1,71 +1,100 @@
 #include "deadlock.h"
+#include "metrics.h"
+#include "trace_events.h"
 #include <algorithm>
 #include <iostream>
 
 
 DeadlockDetector::DeadlockDetector() : has_cycle(false) {}
 
+int DeadlockDetector::intern(const std::string &name) {
+  auto it = id_of.find(name);
+  if (it != id_of.end())
+    return it->second;
+  int id = (int)names.size();
+  id_of.emplace(name, id);
+  names.push_back(name);
+  adj.emplace_back();
+  return id;
+}
+
 void DeadlockDetector::addEdge(const std::string &from, const std::string &to) {
-  adj[from].push_back(to);
-  // Ensure nodes exist in adjacency map even if they have no outgoing edges
-  if (adj.find(to) == adj.end()) {
-    adj[to] = std::vector<std::string>();
-  }
+  int u = intern(from);
+  // Interning also registers nodes that have no outgoing edges
+  int v = intern(to);
+  adj[u].push_back(v);
 }
 
-bool DeadlockDetector::dfs(const std::string &u, std::set<std::string> &visited,
-                           std::set<std::string> &recursion_stack,
-                           std::vector<std::string> &path) {
-  visited.insert(u);
-  recursion_stack.insert(u);
-  path.push_back(u);
+bool DeadlockDetector::findCycle(const std::vector<std::vector<int>> &adj,
+                                 const std::vector<int> &roots,
+                                 std::vector<int> &cycle) {
+  const size_t n = adj.size();
+  std::vector<char> visited(n, 0);
+  std::vector<char> on_path(n, 0);
+  // Explicit DFS stack: the path's nodes and the next edge to try at each
+  std::vector<int> path;
+  std::vector<size_t> next_edge;
+  cycle.clear();
+  long long visits = 0;
+  auto finish = [&visits](bool found) {
+    if (EngineCounters *counters = EngineCounters::active())
+      counters->dfs_visits += visits;
+    return found;
+  };
 
-  for (const auto &v : adj[u]) {
-    if (recursion_stack.count(v)) {
-      // Cycle detected
-      // Capture the cycle part of the path
-      auto it = std::find(path.begin(), path.end(), v);
-      while (it != path.end()) {
-        cycle_path.push_back(*it);
-        it++;
+  for (int root : roots) {
+    if (visited[root])
+      continue;
+    visited[root] = on_path[root] = 1;
+    visits++;
+    path.push_back(root);
+    next_edge.push_back(0);
+
+    while (!path.empty()) {
+      int u = path.back();
+      if (next_edge.back() == adj[u].size()) {
+        on_path[u] = 0;
+        path.pop_back();
+        next_edge.pop_back();
+        continue;
+      }
+      int v = adj[u][next_edge.back()++];
+      if (on_path[v]) {
+        // Back edge: the cycle is the path from v onwards, closed at v
+        auto it = std::find(path.begin(), path.end(), v);
+        cycle.assign(it, path.end());
+        cycle.push_back(v);
+        return finish(true);
+      }
+      if (!visited[v]) {
+        visited[v] = on_path[v] = 1;
+        visits++;
+        path.push_back(v);
+        next_edge.push_back(0);
       }
-      cycle_path.push_back(v); // Close the loop
-      return true;
-    }
-    if (visited.find(v) == visited.end()) {
-      if (dfs(v, visited, recursion_stack, path))
-        return true;
     }
   }
-
-  path.pop_back();
-  recursion_stack.erase(u);
-  return false;
+  return finish(false);
 }
 
 JsonValue DeadlockDetector::detect() {
-  std::set<std::string> visited;
-  std::set<std::string> recursion_stack;
-  std::vector<std::string> path;
-  has_cycle = false;
-  cycle_path.clear();
+  TraceSpan span("deadlock.detect", "deadlock");
+  // Start from nodes in name order, as the search always has
+  std::vector<int> roots(names.size());
+  for (size_t i = 0; i < roots.size(); i++)
+    roots[i] = (int)i;
+  std::sort(roots.begin(), roots.end(),
+            [this](int a, int b) { return names[a] < names[b]; });
 
-  for (const auto &pair : adj) {
-    if (visited.find(pair.first) == visited.end()) {
-      if (dfs(pair.first, visited, recursion_stack, path)) {
-        has_cycle = true;
-        break;
-      }
-    }
-  }
+  has_cycle = findCycle(adj, roots, cycle_path);
 
   JsonValue result = JsonValue::object();
   result["deadlock"] = has_cycle;
 
   JsonValue cycle_arr = JsonValue::array();
   if (has_cycle) {
-    for (const auto &node : cycle_path) {
-      cycle_arr.push_back(node);
+    for (int node : cycle_path) {
+      cycle_arr.push_back(names[node]);
     }
   }
   result["cycle"] = cycle_arr;
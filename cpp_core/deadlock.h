@@ -2,29 +2,33 @@
 #define DEADLOCK_H
 
 #include "json_utils.h"
-#include <map>
-#include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 
 class DeadlockDetector {
 private:
-  std::vector<std::string> processes;
-  std::vector<std::string> resources;
-  std::map<std::string, std::vector<std::string>> adj; // Adjacency list
-  std::vector<std::string> cycle_path;
+  // Node names are interned once; the graph itself is over integer ids
+  std::unordered_map<std::string, int> id_of;
+  std::vector<std::string> names;
+  std::vector<std::vector<int>> adj; // Adjacency list
+  std::vector<int> cycle_path;
   bool has_cycle;
 
-  // DFS helper
-  bool dfs(const std::string &u, std::set<std::string> &visited,
-           std::set<std::string> &recursion_stack,
-           std::vector<std::string> &path);
+  int intern(const std::string &name);
 
 public:
   DeadlockDetector();
   void addEdge(const std::string &from, const std::string &to);
   JsonValue detect(); // Returns deadlock status and cycle if any
+
+  // Depth-first search from each of `roots` in turn over nodes 0..n-1. On the
+  // first back edge, `cycle` gets the cycle's nodes with the first repeated
+  // at the end, and true is returned.
+  static bool findCycle(const std::vector<std::vector<int>> &adj,
+                        const std::vector<int> &roots,
+                        std::vector<int> &cycle);
 };
 
 #endif
@@ -0,0 +1,338 @@
+#include "engine.h"
+#include <charconv>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "banker.h"
+#include "deadlock.h"
+#include "generator.h"
+#include "memory.h"
+#include "mrc.h"
+#include "result_cache.h"
+#include "trace_events.h"
+
+namespace {
+
+// A reference string given inline, or described by a "generate" spec
+std::vector<int> readReferences(const JsonValue &mem_data) {
+  if (mem_data["generate"].type == JsonValue::OBJECT)
+    return generateReferences(ReferenceSpec::fromJson(mem_data["generate"]));
+  const JsonValue &list = mem_data["references"];
+  std::vector<int> refs(list.size());
+  for (size_t i = 0; i < list.size(); i++)
+    refs[i] = (int)list[i].number_val;
+  return refs;
+}
+
+// Process index from "P3" or 3; -1 unless it names one of `processes`
+int processIndex(const JsonValue &v, int processes) {
+  int index = -1;
+  if (v.type == JsonValue::NUMBER) {
+    if (v.number_val >= 0 && v.number_val < processes &&
+        std::floor(v.number_val) == v.number_val)
+      index = (int)v.number_val;
+  } else if (v.type == JsonValue::STRING) {
+    std::string_view name = v.string_val();
+    const char *end = name.data() + name.size();
+    // Digits only, all of them: no sign, spaces or trailing text
+    if (name.size() > 1 && name[0] == 'P' && name[1] >= '0' &&
+        name[1] <= '9') {
+      std::from_chars_result parsed =
+          std::from_chars(name.data() + 1, end, index);
+      if (parsed.ec != std::errc() || parsed.ptr != end)
+        index = -1;
+    }
+  }
+  return index < processes ? index : -1;
+}
+
+// Applies a list of {"process", "request" | "release"} operations in order,
+// after the initial state has been checked
+JsonValue runBankerRequests(BankerAlgorithm &banker, int processes,
+                            const JsonValue &ops) {
+  static const char *const outcomes[] = {"granted", "exceeds_need",
+                                         "must_wait", "unsafe", "invalid"};
+  TraceSpan span("banker.requests", "banker");
+  JsonValue results = JsonValue::array();
+  for (size_t k = 0; k < ops.size(); k++) {
+    const JsonValue &op = ops[k];
+    bool is_release = op["release"].type == JsonValue::ARRAY;
+    const JsonValue &list = is_release ? op["release"] : op["request"];
+    std::vector<int> amounts(list.size());
+    for (size_t j = 0; j < list.size(); j++)
+      amounts[j] = (int)list[j].number_val;
+    int pid = processIndex(op["process"], processes);
+
+    JsonValue result = JsonValue::object();
+    if (pid >= 0)
+      result["process"] = "P" + std::to_string(pid);
+    else
+      result["process"] = op["process"]; // reported as given
+    if (is_release) {
+      result["type"] = "release";
+      result["outcome"] =
+          banker.release(pid, amounts) ? "released" : "invalid";
+    } else {
+      result["type"] = "request";
+      result["outcome"] = outcomes[banker.request(pid, amounts)];
+      result["full_check"] = banker.lastCheckWasFull();
+    }
+    results.push_back(result);
+  }
+  return results;
+}
+
+void execute(JsonValue &input, JsonWriter &writer, const Metrics *timing) {
+  if (input["mode"].type != JsonValue::STRING) {
+    JsonValue output = JsonValue::object();
+    output["error"] = "'mode' field missing or invalid in input JSON.";
+    writer.value(output);
+    return;
+  }
+  std::string mode(input["mode"].string_val());
+  bool streamed = false; // result already written through `writer`
+
+  JsonValue output = JsonValue::object();
+  // Step trace level shared by every mode (DEADLOCK and MRC results carry
+  // no per-step trace, so only their totals are ever written)
+  TraceOptions trace = TraceOptions::fromJson(input["trace"]);
+
+  const JsonValue &metrics_option = input["metrics"];
+  bool with_metrics = metrics_option.type == JsonValue::OBJECT ||
+                      (metrics_option.type == JsonValue::BOOL &&
+                       metrics_option.bool_val);
+  Metrics metrics = timing ? *timing : Metrics();
+  std::unique_ptr<PerfCounters> perf;
+  if (with_metrics && metrics_option["hardware"].type == JsonValue::BOOL &&
+      metrics_option["hardware"].bool_val) {
+    perf.reset(new PerfCounters());
+    metrics.hardware = true;
+    metrics.hardware_reason = perf->reason();
+    for (int e = 0; e < HardwareCounts::EVENTS; e++)
+      metrics.hardware_supported[e] =
+          perf->supported((HardwareCounts::Event)e);
+  }
+  EngineCounters::Scope counter_scope(with_metrics ? &metrics.counters
+                                                   : nullptr);
+  AllocationStats::Scope allocation_scope(with_metrics ? &metrics.allocations
+                                                       : nullptr);
+  writer.timeFlushes(with_metrics);
+  const unsigned long long written_before = writer.bytesWritten();
+  double io_seen = writer.flushSeconds();
+  Metrics::Clock::time_point t = Metrics::Clock::now();
+  // Ends the running phase; time the writer spent in its sink counts as WRITE
+  auto lap = [&](Metrics::Phase phase) {
+    double io = writer.flushSeconds() - io_seen;
+    io_seen += io;
+    t = metrics.lap(phase, t);
+    metrics.seconds[phase] -= io;
+    metrics.seconds[Metrics::WRITE] += io;
+    if (perf)
+      perf->lap(metrics.hardware_counts[phase]);
+  };
+
+  if (mode == "BANKER") {
+    AllocationStats::Tag alloc_tag(AllocationStats::BANKER);
+    JsonValue banker_data = input["banker"];
+    int p, r;
+    std::vector<int> avail;
+    std::vector<std::vector<int>> max_mat;
+    std::vector<std::vector<int>> alloc_mat;
+
+    if (banker_data["generate"].type == JsonValue::OBJECT) {
+      BankerSpec spec = BankerSpec::fromJson(banker_data["generate"]);
+      BankerState state = generateBanker(spec);
+      p = spec.processes;
+      r = spec.resources;
+      avail = state.available;
+      max_mat = state.maximum;
+      alloc_mat = state.allocation;
+    } else {
+      p = (int)banker_data["processes"].number_val;
+      r = (int)banker_data["resources"].number_val;
+
+      for (size_t i = 0; i < banker_data["available"].size(); i++)
+        avail.push_back((int)banker_data["available"][i].number_val);
+
+      for (size_t i = 0; i < banker_data["max"].size(); i++) {
+        std::vector<int> r_row;
+        for (size_t j = 0; j < banker_data["max"][i].size(); j++)
+          r_row.push_back((int)banker_data["max"][i][j].number_val);
+        max_mat.push_back(r_row);
+      }
+
+      for (size_t i = 0; i < banker_data["allocation"].size(); i++) {
+        std::vector<int> r_row;
+        for (size_t j = 0; j < banker_data["allocation"][i].size();
+             j++)
+          r_row.push_back((int)banker_data["allocation"][i][j].number_val);
+        alloc_mat.push_back(r_row);
+      }
+    }
+
+    std::string strategy = banker_data["strategy"].type == JsonValue::STRING
+                               ? std::string(banker_data["strategy"].string_val())
+                               : "scan";
+    BankerAlgorithm banker(p, r, avail, max_mat, alloc_mat, trace);
+    lap(Metrics::BUILD);
+    if (strategy == "scan" || strategy == "queue" || strategy == "parallel") {
+      banker.setStrategy(strategy == "queue"      ? BankerAlgorithm::QUEUE
+                         : strategy == "parallel" ? BankerAlgorithm::PARALLEL
+                                                  : BankerAlgorithm::SCAN);
+      if (banker_data["threads"].number_val >= 1)
+        banker.setThreads((int)banker_data["threads"].number_val);
+      output = banker.solve();
+      if (banker_data["requests"].type == JsonValue::ARRAY)
+        output["requests"] =
+            runBankerRequests(banker, p, banker_data["requests"]);
+    } else {
+      output["error"] = "Unknown Banker strategy: " + strategy;
+    }
+    lap(Metrics::SIMULATE);
+
+  } else if (mode == "DEADLOCK") {
+    AllocationStats::Tag alloc_tag(AllocationStats::DEADLOCK);
+    DeadlockDetector detector;
+    JsonValue dd_data = input["deadlock"];
+    JsonValue edges = dd_data["edges"];
+
+    if (dd_data["generate"].type == JsonValue::OBJECT) {
+      GraphSpec spec = GraphSpec::fromJson(dd_data["generate"]);
+      for (const auto &e : generateGraph(spec))
+        detector.addEdge(e.first, e.second);
+    }
+    for (size_t i = 0; i < edges.size(); i++) {
+      std::string u(edges[i]["from"].string_val());
+      std::string v(edges[i]["to"].string_val());
+      detector.addEdge(u, v);
+    }
+    lap(Metrics::BUILD);
+    output = detector.detect();
+    lap(Metrics::SIMULATE);
+
+  } else if (mode == "MEMORY") {
+    AllocationStats::Tag alloc_tag(AllocationStats::MEMORY);
+    JsonValue mem_data = input["memory"];
+    int frames = (int)mem_data["frames"].number_val;
+    std::string algo(mem_data["algorithm"].string_val());
+    std::vector<int> refs = readReferences(mem_data);
+
+    // Steps are serialized into the output as they are simulated
+    MemoryManager mgr(frames, refs, algo, trace);
+    lap(Metrics::BUILD);
+    writer.beginObject();
+    mgr.simulate(writer);
+    lap(Metrics::SIMULATE);
+    streamed = true;
+
+  } else if (mode == "MRC") {
+    AllocationStats::Tag alloc_tag(AllocationStats::MRC);
+    // Page faults for every frame count 1..frames in one pass
+    JsonValue mem_data = input["memory"];
+    int max_frames = (int)mem_data["frames"].number_val;
+    std::string algo(mem_data["algorithm"].string_val());
+
+    if (mem_data["sampling"].type == JsonValue::OBJECT) {
+      // Approximate curve from a spatially sampled subset of pages
+      JsonValue sampling = mem_data["sampling"];
+      if (algo != "LRU") {
+        output["error"] = "Sampled MRC supports LRU only, got: " + algo;
+      } else {
+        double rate = sampling["rate"].type == JsonValue::NUMBER
+                          ? sampling["rate"].number_val
+                          : 0.01;
+        size_t max_pages = sampling["max_pages"].type == JsonValue::NUMBER
+                               ? (size_t)sampling["max_pages"].number_val
+                               : SampledMissRatioCurve::DEFAULT_MAX_PAGES;
+        SampledMissRatioCurve curve(max_frames, rate, max_pages);
+        lap(Metrics::BUILD);
+        TraceSpan feed_span("mrc.reference", "mrc");
+        if (mem_data["generate"].type == JsonValue::OBJECT) {
+          // Generated references go straight in, never held as a list
+          ReferenceGenerator gen(
+              ReferenceSpec::fromJson(mem_data["generate"]));
+          for (size_t i = 0; i < gen.size(); i++)
+            curve.reference(gen.next());
+        } else {
+          for (int page : readReferences(mem_data))
+            curve.reference(page);
+        }
+        output = curve.compute();
+        lap(Metrics::SIMULATE);
+      }
+    } else {
+      MissRatioCurve curve(max_frames, readReferences(mem_data), algo);
+      lap(Metrics::BUILD);
+      output = curve.compute();
+      lap(Metrics::SIMULATE);
+    }
+
+  } else if (mode == "GENERATE") {
+    AllocationStats::Tag alloc_tag(AllocationStats::GENERATOR);
+    // Writes an input document for the target mode instead of a result
+    writeGenerated(input["generate"], writer);
+    lap(Metrics::SIMULATE);
+    streamed = true;
+
+  } else {
+    output["error"] = "Unknown mode: " + mode;
+  }
+
+  TraceSpan serialize_span("serialize", "json");
+  AllocationStats::Tag alloc_tag(AllocationStats::JSON);
+  // Streamed modes have already opened the object and written its members
+  if (!streamed) {
+    writer.beginObject();
+    for (size_t i = 0; i < output.size(); i++) {
+      writer.key(output.members[i].name());
+      writer.value(output.members[i].value);
+    }
+  }
+  if (with_metrics) {
+    lap(Metrics::SERIALIZE);
+    writer.flush();
+    lap(Metrics::WRITE);
+    if (perf) {
+      // Only known once the counters have been read
+      metrics.hardware_reason = perf->reason();
+      metrics.hardware_multiplexed = perf->multiplexed();
+    }
+    metrics.bytes_written = writer.bytesWritten() - written_before;
+    metrics.peak_rss_bytes = AllocationStats::peakResidentBytes();
+    writer.key("metrics");
+    metrics.write(writer);
+  }
+  writer.endObject();
+}
+
+} // namespace
+
+void runRequest(JsonValue &input, JsonWriter &writer, const Metrics *timing,
+                ResultCache *cache) {
+  std::string key;
+  if (cache)
+    key = ResultCache::keyOf(input, writer.indent());
+  if (key.empty()) {
+    execute(input, writer, timing);
+    return;
+  }
+  std::string bytes;
+  {
+    TraceSpan lookup_span("cache.lookup", "cache");
+    if (cache->lookup(key, bytes)) {
+      writer.raw(bytes);
+      return;
+    }
+  }
+  writer.beginCapture(bytes, cache->maxEntryBytes());
+  try {
+    execute(input, writer, timing);
+  } catch (...) {
+    writer.endCapture();
+    throw;
+  }
+  if (writer.endCapture())
+    cache->store(key, bytes);
+}
@@ -0,0 +1,19 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "json_utils.h"
+#include "metrics.h"
+
+class ResultCache;
+
+// Runs the simulation described by one input document (BANKER, DEADLOCK,
+// MEMORY, MRC or GENERATE mode) and writes its result object through
+// `writer`. Problems with the request itself are reported as an "error"
+// field. With "metrics": true in the input the result ends with a "metrics"
+// object; `timing` carries the read and parse phases the caller measured.
+// With a `cache`, a request seen before is answered with the stored result
+// bytes, and a new result is stored as it is written.
+void runRequest(JsonValue &input, JsonWriter &writer,
+                const Metrics *timing = nullptr, ResultCache *cache = nullptr);
+
+#endif
@@ -0,0 +1,323 @@
+#include "generator.h"
+#include "alloc_tracker.h"
+#include "trace_events.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+// Reads an optional numeric field, keeping `fallback` when it is absent
+double number(const JsonValue &v, const char *key, double fallback) {
+  const JsonValue &field = v[key];
+  return field.type == JsonValue::NUMBER ? field.number_val : fallback;
+}
+
+uint64_t seedOf(const JsonValue &v) {
+  return (uint64_t)std::max(0.0, number(v, "seed", 1));
+}
+
+// Fisher-Yates shuffle of 0..n-1 driven by `rng`
+std::vector<int> permutation(int n, Xoshiro256 &rng) {
+  std::vector<int> order(n > 0 ? n : 0);
+  for (int i = 0; i < n; i++)
+    order[i] = i;
+  for (int i = n - 1; i > 0; i--)
+    std::swap(order[i], order[rng.below((uint32_t)i + 1)]);
+  return order;
+}
+
+} // namespace
+
+ReferenceSpec ReferenceSpec::fromJson(const JsonValue &v) {
+  ReferenceSpec spec;
+  if (v["pattern"].type == JsonValue::STRING)
+    spec.pattern = std::string(v["pattern"].string_val());
+  if (spec.pattern != "sequential" && spec.pattern != "loop" &&
+      spec.pattern != "zipf" && spec.pattern != "phase" &&
+      spec.pattern != "mixed")
+    throw std::invalid_argument("Unknown reference pattern: " + spec.pattern);
+  spec.length = (size_t)std::max(0.0, number(v, "length", 1000));
+  spec.pages = std::max(1, (int)number(v, "pages", 64));
+  spec.loop = std::min(spec.pages, std::max(1, (int)number(v, "loop", 16)));
+  spec.working_set =
+      std::min(spec.pages, std::max(1, (int)number(v, "working_set", 8)));
+  spec.phase_length =
+      (size_t)std::max(1.0, number(v, "phase_length", 1000));
+  spec.zipf = std::max(0.0, number(v, "zipf", 1.0));
+  spec.seed = seedOf(v);
+  return spec;
+}
+
+ReferenceGenerator::ReferenceGenerator(const ReferenceSpec &spec)
+    : spec(spec), rng(spec.seed) {
+  AllocationStats::Tag alloc_tag(AllocationStats::GENERATOR);
+  if (spec.pattern == "sequential")
+    pattern = SEQUENTIAL;
+  else if (spec.pattern == "loop")
+    pattern = LOOP;
+  else if (spec.pattern == "zipf")
+    pattern = ZIPF;
+  else if (spec.pattern == "phase")
+    pattern = PHASE;
+  else
+    pattern = MIXED;
+  current = pattern;
+
+  if (pattern == ZIPF || pattern == MIXED) {
+    // Cumulative weights, searched with one uniform draw per reference
+    zipf_cdf.resize(spec.pages);
+    double total = 0;
+    for (int k = 0; k < spec.pages; k++) {
+      total += 1.0 / std::pow((double)(k + 1), spec.zipf);
+      zipf_cdf[k] = total;
+    }
+    for (double &c : zipf_cdf)
+      c /= total;
+  }
+}
+
+void ReferenceGenerator::startSegment() {
+  if (pattern == MIXED)
+    current = (Pattern)rng.below(4);
+  window = rng.below((uint32_t)spec.pages);
+}
+
+int ReferenceGenerator::next() {
+  if (produced % spec.phase_length == 0)
+    startSegment();
+  size_t i = produced++;
+  switch (current) {
+  case SEQUENTIAL:
+    return (int)(i % spec.pages);
+  case LOOP:
+    return (int)(i % spec.loop);
+  case ZIPF: {
+    double u = rng.uniform();
+    size_t k = std::upper_bound(zipf_cdf.begin(), zipf_cdf.end(), u) -
+               zipf_cdf.begin();
+    return (int)std::min(k, zipf_cdf.size() - 1);
+  }
+  case PHASE:
+  default:
+    return (int)((window + rng.below((uint32_t)spec.working_set)) %
+                 (uint32_t)spec.pages);
+  }
+}
+
+std::vector<int> generateReferences(const ReferenceSpec &spec) {
+  AllocationStats::Tag alloc_tag(AllocationStats::GENERATOR);
+  ReferenceGenerator gen(spec);
+  std::vector<int> refs(gen.size());
+  for (int &page : refs)
+    page = gen.next();
+  return refs;
+}
+
+BankerSpec BankerSpec::fromJson(const JsonValue &v) {
+  BankerSpec spec;
+  spec.processes = std::max(0, (int)number(v, "processes", 5));
+  spec.resources = std::max(0, (int)number(v, "resources", 3));
+  spec.density = std::min(1.0, std::max(0.0, number(v, "density", 1.0)));
+  spec.max_units = std::max(1, (int)number(v, "max_units", 10));
+  if (v["safe"].type == JsonValue::BOOL)
+    spec.safe = v["safe"].bool_val;
+  spec.seed = seedOf(v);
+  return spec;
+}
+
+BankerState generateBanker(const BankerSpec &spec) {
+  AllocationStats::Tag alloc_tag(AllocationStats::GENERATOR);
+  const int p = spec.processes;
+  const int r = spec.resources;
+  Xoshiro256 rng(spec.seed);
+  BankerState state;
+  state.available.assign(r, 0);
+  state.allocation.assign(p, std::vector<int>(r, 0));
+  std::vector<std::vector<int>> need(p, std::vector<int>(r, 0));
+
+  for (int i = 0; i < p; i++) {
+    for (int j = 0; j < r; j++) {
+      if (rng.uniform() >= spec.density)
+        continue;
+      int claim = 1 + (int)rng.below((uint32_t)spec.max_units);
+      state.allocation[i][j] = (int)rng.below((uint32_t)claim + 1);
+      need[i][j] = claim - state.allocation[i][j];
+    }
+  }
+
+  // Smallest `available` that lets the first `runnable` processes of a
+  // random order finish one after another
+  std::vector<int> order = permutation(p, rng);
+  int runnable = (spec.safe || r == 0) ? p : p / 2;
+  std::vector<long long> released(r, 0);
+  for (int k = 0; k < runnable; k++) {
+    for (int j = 0; j < r; j++) {
+      long long short_by = need[order[k]][j] - released[j];
+      if (short_by > state.available[j])
+        state.available[j] = (int)short_by;
+    }
+    for (int j = 0; j < r; j++)
+      released[j] += state.allocation[order[k]][j];
+  }
+
+  // The rest need more of resource 0 than could ever be free
+  long long ceiling = r > 0 ? state.available[0] + released[0] : 0;
+  for (int k = runnable; k < p; k++)
+    need[order[k]][0] =
+        (int)(ceiling + 1 + rng.below((uint32_t)spec.max_units));
+
+  state.maximum.assign(p, std::vector<int>(r, 0));
+  for (int i = 0; i < p; i++)
+    for (int j = 0; j < r; j++)
+      state.maximum[i][j] = state.allocation[i][j] + need[i][j];
+  return state;
+}
+
+GraphSpec GraphSpec::fromJson(const JsonValue &v) {
+  GraphSpec spec;
+  spec.processes = std::max(0, (int)number(v, "processes", 5));
+  spec.resources = std::max(0, (int)number(v, "resources", 5));
+  spec.density = std::min(1.0, std::max(0.0, number(v, "density", 0.3)));
+  spec.cycles = std::max(0, (int)number(v, "cycles", 0));
+  spec.cycle_length = std::max(1, (int)number(v, "cycle_length", 2));
+  spec.seed = seedOf(v);
+  return spec;
+}
+
+std::vector<std::pair<std::string, std::string>>
+generateGraph(const GraphSpec &spec) {
+  AllocationStats::Tag alloc_tag(AllocationStats::GENERATOR);
+  const int p = spec.processes;
+  const int r = spec.resources;
+  Xoshiro256 rng(spec.seed);
+  auto process = [](int i) { return "P" + std::to_string(i); };
+  auto resource = [](int j) { return "R" + std::to_string(j); };
+  std::vector<std::pair<std::string, std::string>> edges;
+
+  // Base graph: every edge goes from a lower to a higher rank (processes
+  // are nodes 0..p-1, resources p..p+r-1), so it has no cycles
+  std::vector<int> rank(p + r);
+  std::vector<int> order = permutation(p + r, rng);
+  for (int k = 0; k < p + r; k++)
+    rank[order[k]] = k;
+  std::vector<int> holder(r, -1);
+  std::vector<int> picked_by(r, -1); // dedups a process's resource draws
+  for (int i = 0; i < p && r > 0; i++) {
+    int degree = (int)(spec.density * r + rng.uniform());
+    for (int k = 0; k < degree; k++) {
+      int j = (int)rng.below((uint32_t)r);
+      if (picked_by[j] == i)
+        continue;
+      picked_by[j] = i;
+      if (rank[i] < rank[p + j]) {
+        edges.emplace_back(process(i), resource(j)); // request
+      } else if (holder[j] == -1) {
+        holder[j] = i; // single instance: one assignment per resource
+        edges.emplace_back(resource(j), process(i));
+      }
+    }
+  }
+
+  // Planted cycles P a0 -> R b0 -> P a1 -> R b1 -> ... -> P a0
+  int length = std::min(spec.cycle_length, std::min(p, r));
+  for (int c = 0; c < spec.cycles && length > 0; c++) {
+    std::vector<int> procs = permutation(p, rng);
+    std::vector<int> res = permutation(r, rng);
+    for (int k = 0; k < length; k++) {
+      edges.emplace_back(process(procs[k]), resource(res[k]));
+      edges.emplace_back(resource(res[k]), process(procs[(k + 1) % length]));
+    }
+  }
+  return edges;
+}
+
+void writeGenerated(const JsonValue &spec, JsonWriter &out) {
+  TraceSpan span("generate", "generator");
+  AllocationStats::Tag alloc_tag(AllocationStats::GENERATOR);
+  std::string target = spec["target"].type == JsonValue::STRING
+                           ? std::string(spec["target"].string_val())
+                           : "MEMORY";
+  // Validate and build the state before anything is written, so a failure
+  // leaves `out` untouched; only the references are produced while writing
+  if (target != "MEMORY" && target != "BANKER" && target != "DEADLOCK")
+    throw std::invalid_argument("Unknown generate target: " + target);
+  std::unique_ptr<ReferenceGenerator> gen;
+  BankerSpec banker;
+  BankerState state;
+  std::vector<std::pair<std::string, std::string>> edges;
+  if (target == "MEMORY") {
+    gen.reset(new ReferenceGenerator(ReferenceSpec::fromJson(spec)));
+  } else if (target == "BANKER") {
+    banker = BankerSpec::fromJson(spec);
+    state = generateBanker(banker);
+  } else {
+    edges = generateGraph(GraphSpec::fromJson(spec));
+  }
+  out.beginObject();
+
+  if (target == "MEMORY") {
+    out.key("memory");
+    out.beginObject();
+    out.key("algorithm");
+    out.value(spec["algorithm"].type == JsonValue::STRING
+                  ? spec["algorithm"].string_val()
+                  : std::string_view("LRU"));
+    out.key("frames");
+    out.value((int)number(spec, "frames", 3));
+    out.key("references");
+    out.beginArray();
+    for (size_t i = 0; i < gen->size(); i++)
+      out.value(gen->next());
+    out.endArray();
+    out.endObject();
+
+  } else if (target == "BANKER") {
+    auto matrix = [&out](const std::vector<std::vector<int>> &m) {
+      out.beginArray();
+      for (const auto &row : m) {
+        out.beginArray();
+        for (int x : row)
+          out.value(x);
+        out.endArray();
+      }
+      out.endArray();
+    };
+    out.key("banker");
+    out.beginObject();
+    out.key("allocation");
+    matrix(state.allocation);
+    out.key("available");
+    out.beginArray();
+    for (int x : state.available)
+      out.value(x);
+    out.endArray();
+    out.key("max");
+    matrix(state.maximum);
+    out.key("processes");
+    out.value(banker.processes);
+    out.key("resources");
+    out.value(banker.resources);
+    out.endObject();
+
+  } else {
+    out.key("deadlock");
+    out.beginObject();
+    out.key("edges");
+    out.beginArray();
+    for (const auto &e : edges) {
+      out.beginObject();
+      out.key("from");
+      out.value(e.first);
+      out.key("to");
+      out.value(e.second);
+      out.endObject();
+    }
+    out.endArray();
+    out.endObject();
+  }
+
+  out.key("mode");
+  out.value(target);
+}
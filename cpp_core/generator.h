@@ -0,0 +1,148 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "json_utils.h"
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Deterministic synthetic workloads. Everything is derived from a seed with
+// our own generator and integer arithmetic (no <random> distributions, whose
+// output differs between standard libraries), so a spec produces the same
+// workload on every platform.
+
+// xoshiro256** seeded through splitmix64
+class Xoshiro256 {
+private:
+  uint64_t s[4];
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+  explicit Xoshiro256(uint64_t seed) {
+    for (uint64_t &word : s) {
+      uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      word = z ^ (z >> 31);
+    }
+  }
+
+  uint64_t next() {
+    uint64_t result = rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+    return result;
+  }
+
+  // Uniform in [0, n), n > 0 (multiply-shift; the bias is below 2^-32)
+  uint32_t below(uint32_t n) {
+    return (uint32_t)(((next() >> 32) * (uint64_t)n) >> 32);
+  }
+
+  // Uniform in [0, 1) with 53 random bits
+  double uniform() { return (double)(next() >> 11) * 0x1.0p-53; }
+};
+
+// Reference string shape, read from a "generate" object:
+//   "sequential"  pages 0, 1, ..., pages-1, 0, 1, ... (a scan)
+//   "loop"        pages 0..loop-1 repeated
+//   "zipf"        independent draws, page k with weight 1/(k+1)^zipf
+//   "phase"       uniform over a `working_set`-page window that moves to a
+//                 random place every `phase_length` references
+//   "mixed"       segments of `phase_length` references, each one of the
+//                 patterns above chosen at random
+struct ReferenceSpec {
+  std::string pattern = "mixed";
+  size_t length = 1000;
+  int pages = 64;
+  int loop = 16;
+  int working_set = 8;
+  size_t phase_length = 1000;
+  double zipf = 1.0;
+  uint64_t seed = 1;
+
+  // Throws std::invalid_argument for an unknown pattern
+  static ReferenceSpec fromJson(const JsonValue &v);
+};
+
+// Produces a spec's references one at a time, so long strings can be
+// streamed without being held in memory
+class ReferenceGenerator {
+private:
+  enum Pattern { SEQUENTIAL, LOOP, ZIPF, PHASE, MIXED };
+
+  ReferenceSpec spec;
+  Pattern pattern;
+  Pattern current; // pattern of the running segment (MIXED)
+  Xoshiro256 rng;
+  std::vector<double> zipf_cdf;
+  size_t produced = 0;
+  uint32_t window = 0; // first page of the PHASE window
+
+  void startSegment();
+
+public:
+  explicit ReferenceGenerator(const ReferenceSpec &spec);
+  size_t size() const { return spec.length; }
+  int next();
+};
+
+std::vector<int> generateReferences(const ReferenceSpec &spec);
+
+// Banker's state with `density` the share of non-zero (process, resource)
+// claims, each at most `max_units`. A safe state is safe by construction (a
+// random finishing order is made feasible); an unsafe one lets half of the
+// processes finish and gives the rest a need for resource 0 beyond anything
+// that can ever be released.
+struct BankerSpec {
+  int processes = 5;
+  int resources = 3;
+  double density = 1.0;
+  int max_units = 10;
+  bool safe = true;
+  uint64_t seed = 1;
+
+  static BankerSpec fromJson(const JsonValue &v);
+};
+
+struct BankerState {
+  std::vector<int> available;
+  std::vector<std::vector<int>> maximum;
+  std::vector<std::vector<int>> allocation;
+};
+
+BankerState generateBanker(const BankerSpec &spec);
+
+// Resource allocation graph over processes P0.. and single-instance
+// resources R0..: each process requests or holds about `density` of the
+// resources, always along a random global order so the graph is acyclic,
+// and then `cycles` cycles of `cycle_length` processes are planted.
+struct GraphSpec {
+  int processes = 5;
+  int resources = 5;
+  double density = 0.3;
+  int cycles = 0;
+  int cycle_length = 2;
+  uint64_t seed = 1;
+
+  static GraphSpec fromJson(const JsonValue &v);
+};
+
+std::vector<std::pair<std::string, std::string>>
+generateGraph(const GraphSpec &spec);
+
+// GENERATE mode: opens the input document for "target" (MEMORY, BANKER or
+// DEADLOCK) built from the spec and writes its members, ready to be fed back
+// to the simulators; the caller closes the object. References are streamed
+// straight into `out`; everything else is built first, so a bad spec or a
+// failed allocation throws before anything is written.
+void writeGenerated(const JsonValue &spec, JsonWriter &out);
+
+#endif
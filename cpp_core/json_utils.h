@@ -3,115 +3,551 @@
 
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
 #include <sstream>
 #include <fstream>
 #include <algorithm>
+#include <charconv>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include "mapped_file.h"
 
-// A minimal JSON value wrapper
+// Bump allocator holding the children and string bytes of JsonValues.
+// Nothing is freed individually; the whole document goes away at once when
+// the arena is reset or destroyed.
+class JsonArena {
+    struct Block {
+        Block* next;
+        size_t size;
+        size_t used;
+        alignas(std::max_align_t) char data[1];
+    };
+    Block* blocks = nullptr; // newest first
+    size_t next_block_size;
+
+    static Block* newBlock(size_t size) {
+        Block* b = static_cast<Block*>(::operator new(offsetof(Block, data) + size));
+        b->next = nullptr;
+        b->size = size;
+        b->used = 0;
+        return b;
+    }
+
+public:
+    explicit JsonArena(size_t first_block = 64 * 1024) : next_block_size(first_block) {}
+    ~JsonArena() { release(); }
+    JsonArena(const JsonArena&) = delete;
+    JsonArena& operator=(const JsonArena&) = delete;
+
+    void* allocate(size_t bytes) {
+        bytes = (bytes + 7) & ~size_t(7);
+        if (!blocks || blocks->size - blocks->used < bytes) {
+            size_t size = std::max(next_block_size, bytes);
+            Block* b = newBlock(size);
+            b->next = blocks;
+            blocks = b;
+            if (next_block_size < (size_t(16) << 20)) next_block_size *= 2;
+        }
+        void* p = blocks->data + blocks->used;
+        blocks->used += bytes;
+        return p;
+    }
+
+    // Drops every value but keeps the largest block for the next document
+    void reset() {
+        Block* keep = nullptr;
+        for (Block* b = blocks; b; ) {
+            Block* next = b->next;
+            if (!keep || b->size > keep->size) {
+                if (keep) ::operator delete(keep);
+                keep = b;
+            } else {
+                ::operator delete(b);
+            }
+            b = next;
+        }
+        blocks = keep;
+        if (blocks) {
+            blocks->next = nullptr;
+            blocks->used = 0;
+        }
+    }
+
+    void release() {
+        while (blocks) {
+            Block* next = blocks->next;
+            ::operator delete(blocks);
+            blocks = next;
+        }
+    }
+
+    size_t bytesReserved() const {
+        size_t total = 0;
+        for (Block* b = blocks; b; b = b->next) total += b->size;
+        return total;
+    }
+
+    // Arena that JsonValues created on this thread allocate from: the
+    // innermost active Scope, or a per-thread fallback arena.
+    static JsonArena*& active() {
+        static thread_local JsonArena* arena = nullptr;
+        return arena;
+    }
+    static JsonArena& current() {
+        JsonArena* a = active();
+        if (a) return *a;
+        static thread_local JsonArena fallback;
+        return fallback;
+    }
+
+    class Scope {
+        JsonArena* saved;
+    public:
+        explicit Scope(JsonArena& arena) : saved(active()) { active() = &arena; }
+        ~Scope() { active() = saved; }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+};
+
+struct JsonMember;
+
+// A minimal JSON value: a 16-byte tagged union. Array items, object members
+// (kept sorted by key) and string bytes live in the current JsonArena, so a
+// JsonValue is trivially copyable and copies are shallow; a copy shares its
+// children with the original and must not be grown independently of it.
 struct JsonValue {
-    enum Type { NULL_VAL, OBJECT, ARRAY, STRING, NUMBER, BOOL };
+    enum Type : uint8_t { NULL_VAL, OBJECT, ARRAY, STRING, NUMBER, BOOL };
     Type type = NULL_VAL;
-    
-    std::map<std::string, JsonValue> object_val;
-    std::vector<JsonValue> array_val;
-    std::string string_val;
-    double number_val = 0;
-    bool bool_val = false;
+    uint32_t len = 0; // items, members or string bytes
+
+    union {
+        double number_val;
+        bool bool_val;
+        const char* chars;
+        JsonValue* items;
+        JsonMember* members;
+    };
 
-    JsonValue() {}
+    JsonValue() : number_val(0) {}
     JsonValue(double d) : type(NUMBER), number_val(d) {}
     JsonValue(int i) : type(NUMBER), number_val(i) {}
     JsonValue(bool b) : type(BOOL), bool_val(b) {}
-    JsonValue(std::string s) : type(STRING), string_val(s) {}
-    JsonValue(const char* s) : type(STRING), string_val(s) {}
+    JsonValue(std::string_view s) : type(STRING), len((uint32_t)s.size()) {
+        char* p = static_cast<char*>(JsonArena::current().allocate(s.size()));
+        if (!s.empty()) memcpy(p, s.data(), s.size());
+        chars = p;
+    }
+    JsonValue(const std::string& s) : JsonValue(std::string_view(s)) {}
+    JsonValue(const char* s) : JsonValue(std::string_view(s)) {}
 
-    static JsonValue object() { JsonValue v; v.type = OBJECT; return v; }
-    static JsonValue array() { JsonValue v; v.type = ARRAY; return v; }
+    static JsonValue object() { JsonValue v; v.type = OBJECT; v.members = nullptr; return v; }
+    static JsonValue array() { JsonValue v; v.type = ARRAY; v.items = nullptr; return v; }
 
-    JsonValue& operator[](const std::string& key) {
-        if (type == NULL_VAL) type = OBJECT;
-        return object_val[key];
+    // Slots reserved for n children; growth doubles, so it is implied by n
+    static size_t capacityFor(size_t n) {
+        if (n == 0) return 0;
+        size_t cap = 4;
+        while (cap < n) cap *= 2;
+        return cap;
     }
-    
+
+    size_t size() const { return (type == ARRAY || type == OBJECT) ? len : 0; }
+    std::string_view string_val() const {
+        return type == STRING ? std::string_view(chars, len) : std::string_view();
+    }
+
+    JsonValue& operator[](std::string_view key);
+    const JsonValue& operator[](std::string_view key) const;
+
     JsonValue& operator[](size_t index) {
-        if (type == NULL_VAL) type = ARRAY;
-         if (index >= array_val.size()) array_val.resize(index + 1);
-        return array_val[index];
+        if (type == NULL_VAL) *this = array();
+        if (index >= len) resize(index + 1);
+        return items[index];
+    }
+    const JsonValue& operator[](size_t index) const {
+        static const JsonValue null_value;
+        return (type == ARRAY && index < len) ? items[index] : null_value;
     }
 
     void push_back(const JsonValue& v) {
-        if (type == NULL_VAL) type = ARRAY;
-        array_val.push_back(v);
+        if (type == NULL_VAL) *this = array();
+        JsonValue copy = v; // v may live in the block being replaced
+        grow(len + 1);
+        items[len++] = copy;
     }
-    
-    std::string dump(int indent = 0) const {
-        std::string s;
-        std::string pad(indent, ' ');
-        switch(type) {
-            case NULL_VAL: return "null";
-            case NUMBER: {
-                std::string num = std::to_string(number_val);
-                // Remove trailing zeros
-                num.erase ( num.find_last_not_of('0') + 1, std::string::npos );
-                if (num.back() == '.') num.pop_back();
-                return num;
+
+    void resize(size_t n) {
+        grow(n);
+        for (size_t i = len; i < n; i++) items[i] = JsonValue();
+        len = (uint32_t)n;
+    }
+
+    std::string dump(int indent = 0) const;
+
+private:
+    template <typename T>
+    static T* allocateSlots(size_t n) {
+        return static_cast<T*>(JsonArena::current().allocate(capacityFor(n) * sizeof(T)));
+    }
+    void grow(size_t n);
+};
+
+struct JsonMember {
+    const char* key;
+    uint32_t key_len;
+    JsonValue value;
+
+    std::string_view name() const { return std::string_view(key, key_len); }
+};
+
+static_assert(sizeof(JsonValue) == 16, "JsonValue should stay a 16-byte node");
+
+inline void JsonValue::grow(size_t n) {
+    if (n <= capacityFor(len)) return;
+    if (type == OBJECT) {
+        JsonMember* fresh = allocateSlots<JsonMember>(n);
+        if (len) memcpy(static_cast<void*>(fresh), members, len * sizeof(JsonMember));
+        members = fresh;
+    } else {
+        JsonValue* fresh = allocateSlots<JsonValue>(n);
+        if (len) memcpy(static_cast<void*>(fresh), items, len * sizeof(JsonValue));
+        items = fresh;
+    }
+}
+
+inline JsonValue& JsonValue::operator[](std::string_view key) {
+    if (type == NULL_VAL) *this = object();
+    JsonMember* first = members;
+    JsonMember* last = members + len;
+    JsonMember* it = std::lower_bound(first, last, key,
+        [](const JsonMember& m, std::string_view k) { return m.name() < k; });
+    if (it != last && it->name() == key) return it->value;
+
+    // Insert keeping members sorted, as std::map did for dump()
+    size_t at = it - first;
+    grow(len + 1);
+    if (at < len)
+        memmove(static_cast<void*>(members + at + 1), members + at, (len - at) * sizeof(JsonMember));
+    char* k = static_cast<char*>(JsonArena::current().allocate(key.size()));
+    if (!key.empty()) memcpy(k, key.data(), key.size());
+    members[at].key = k;
+    members[at].key_len = (uint32_t)key.size();
+    members[at].value = JsonValue();
+    len++;
+    return members[at].value;
+}
+
+inline const JsonValue& JsonValue::operator[](std::string_view key) const {
+    static const JsonValue null_value;
+    if (type != OBJECT) return null_value;
+    const JsonMember* first = members;
+    const JsonMember* last = members + len;
+    const JsonMember* it = std::lower_bound(first, last, key,
+        [](const JsonMember& m, std::string_view k) { return m.name() < k; });
+    return (it != last && it->name() == key) ? it->value : null_value;
+}
+
+// Serializes JSON into a fixed-size buffer that is flushed to a FILE*,
+// an ostream or a string as it fills, so values can be written as they are
+// produced without building the document first. Pretty output matches the
+// historical JsonValue::dump layout (`indent` is the starting pad); a
+// negative indent writes compact JSON.
+class JsonWriter {
+public:
+    explicit JsonWriter(std::FILE* file, int indent = 0) : JsonWriter(indent) { sink_file = file; }
+    explicit JsonWriter(std::ostream& os, int indent = 0) : JsonWriter(indent) { sink_stream = &os; }
+    explicit JsonWriter(std::string& str, int indent = 0) : JsonWriter(indent) { sink_string = &str; }
+    ~JsonWriter() { flush(); }
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter& operator=(const JsonWriter&) = delete;
+
+    void beginObject() { beforeValue(); put('{'); open(); }
+    void endObject() { close('}'); }
+    void beginArray() { beforeValue(); put('['); open(); }
+    void endArray() { close(']'); }
+
+    void key(std::string_view k) {
+        separate();
+        putString(k);
+        if (pretty()) write(": ", 2); else put(':');
+        after_key = true;
+    }
+
+    void null() { beforeValue(); write("null", 4); }
+    void value(bool b) { beforeValue(); if (b) write("true", 4); else write("false", 5); }
+    void value(int i) { beforeValue(); putInteger(i); }
+    void value(long long i) { beforeValue(); putInteger(i); }
+    void value(double d) {
+        beforeValue();
+        // Page numbers, counts and frame contents are whole numbers: print
+        // them as integers; anything else gets the shortest representation
+        // that reads back to the same double.
+        if (d >= -9007199254740992.0 && d <= 9007199254740992.0 && d == (double)(long long)d) {
+            putInteger((long long)d);
+            return;
+        }
+        if (d != d || d - d != 0) { write("null", 4); return; } // NaN / inf
+        reserve(32);
+        auto res = std::to_chars(buf + used, buf + BUFFER_SIZE, d);
+        used = res.ptr - buf;
+    }
+    void value(std::string_view str) { beforeValue(); putString(str); }
+    void value(const char* str) { value(std::string_view(str)); }
+    void value(const std::string& str) { value(std::string_view(str)); }
+    void value(const struct JsonValue& v);
+
+    // A value serialized earlier by a writer with the same indent, at the
+    // top level or after a key
+    void raw(std::string_view json) { beforeValue(); write(json.data(), json.size()); }
+
+    int indent() const { return base_indent; }
+
+    void flush() {
+        if (used == 0) return;
+        sink(buf, used);
+        used = 0;
+    }
+
+    // Terminates one newline-delimited document and pushes it to the sink
+    void endLine() {
+        put('\n');
+        flush();
+        if (sink_file) fflush(sink_file);
+        else if (sink_stream) sink_stream->flush();
+    }
+
+    unsigned long long bytesWritten() const { return flushed + used; }
+
+    // Optionally accumulates the time spent handing output to the sink
+    void timeFlushes(bool on) { timed = on; }
+    double flushSeconds() const { return flush_seconds; }
+
+    // Copies everything written from now on into `copy` as well, giving up
+    // once it would exceed `limit` bytes; endCapture() says whether the copy
+    // is complete
+    void beginCapture(std::string& copy, size_t limit) {
+        flush();
+        copy.clear();
+        capture_to = &copy;
+        capture_limit = limit;
+        capture_complete = true;
+    }
+    bool endCapture() {
+        flush();
+        capture_to = nullptr;
+        return capture_complete;
+    }
+
+private:
+    static const size_t BUFFER_SIZE = 64 * 1024;
+
+    char buf[BUFFER_SIZE];
+    size_t used = 0;
+    unsigned long long flushed = 0;
+    std::FILE* sink_file = nullptr;
+    std::ostream* sink_stream = nullptr;
+    std::string* sink_string = nullptr;
+    bool timed = false;
+    double flush_seconds = 0;
+    std::string* capture_to = nullptr;
+    size_t capture_limit = 0;
+    bool capture_complete = false;
+
+    int base_indent;
+    int depth = 0;
+    uint64_t has_items = 0; // bit per open container (first 64 levels)
+    bool after_key = false;
+
+    explicit JsonWriter(int indent) : base_indent(indent) {}
+
+    bool pretty() const { return base_indent >= 0; }
+
+    void sink(const char* p, size_t n) {
+        std::chrono::steady_clock::time_point start;
+        if (timed) start = std::chrono::steady_clock::now();
+        if (sink_file) fwrite(p, 1, n, sink_file);
+        else if (sink_stream) sink_stream->write(p, (std::streamsize)n);
+        else if (sink_string) sink_string->append(p, n);
+        flushed += n;
+        if (capture_to) {
+            if (capture_to->size() + n <= capture_limit) {
+                capture_to->append(p, n);
+            } else {
+                std::string().swap(*capture_to);
+                capture_to = nullptr;
+                capture_complete = false;
+            }
+        }
+        if (timed)
+            flush_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void write(const char* p, size_t n) {
+        if (n > BUFFER_SIZE - used) {
+            flush();
+            if (n > BUFFER_SIZE) {
+                sink(p, n);
+                return;
+            }
+        }
+        memcpy(buf + used, p, n);
+        used += n;
+    }
+    void reserve(size_t n) {
+        if (n > BUFFER_SIZE - used) flush();
+    }
+    template <typename Int>
+    void putInteger(Int i) {
+        reserve(24);
+        auto res = std::to_chars(buf + used, buf + BUFFER_SIZE, i);
+        used = res.ptr - buf;
+    }
+    void put(char c) {
+        if (used == BUFFER_SIZE) flush();
+        buf[used++] = c;
+    }
+    void pad(int n) {
+        for (int i = 0; i < n; i++) put(' ');
+    }
+
+    void putString(std::string_view str) {
+        put('"');
+        size_t start = 0;
+        for (size_t i = 0; i < str.size(); i++) {
+            unsigned char c = (unsigned char)str[i];
+            if (c != '"' && c != '\\' && c >= 0x20) continue;
+            write(str.data() + start, i - start);
+            start = i + 1;
+            char esc[8];
+            switch (c) {
+                case '"': write("\\\"", 2); break;
+                case '\\': write("\\\\", 2); break;
+                case '\n': write("\\n", 2); break;
+                case '\t': write("\\t", 2); break;
+                case '\r': write("\\r", 2); break;
+                default: snprintf(esc, sizeof(esc), "\\u%04x", c); write(esc, 6); break;
             }
-            case BOOL: return bool_val ? "true" : "false";
-            case STRING: return "\"" + string_val + "\"";
-            case ARRAY:
-                s = "[\n";
-                for (size_t i = 0; i < array_val.size(); i++) {
-                    s += pad + "  " + array_val[i].dump(indent + 2);
-                    if (i < array_val.size() - 1) s += ",";
-                    s += "\n";
-                }
-                s += pad + "]";
-                return s;
-            case OBJECT:
-                s = "{\n";
-                int i = 0;
-                for (auto& kv : object_val) {
-                    s += pad + "  \"" + kv.first + "\": " + kv.second.dump(indent + 2);
-                    if (i < object_val.size() - 1) s += ",";
-                    s += "\n";
-                    i++;
-                }
-                s += pad + "}";
-                return s;
         }
-        return "";
+        write(str.data() + start, str.size() - start);
+        put('"');
+    }
+
+    // Comma and line break before the next member or item of a container
+    void separate() {
+        if (depth == 0) return;
+        uint64_t bit = uint64_t(1) << ((depth - 1) & 63);
+        if (has_items & bit) put(',');
+        has_items |= bit;
+        if (pretty()) {
+            put('\n');
+            pad(base_indent + 2 * depth);
+        }
+    }
+    void beforeValue() {
+        if (after_key) { after_key = false; return; }
+        separate();
+    }
+    void open() {
+        depth++;
+        has_items &= ~(uint64_t(1) << ((depth - 1) & 63));
+    }
+    void close(char c) {
+        depth--;
+        if (pretty()) {
+            put('\n');
+            pad(base_indent + 2 * depth);
+        }
+        put(c);
     }
 };
 
+inline void JsonWriter::value(const JsonValue& v) {
+    switch (v.type) {
+        case JsonValue::NULL_VAL: null(); break;
+        case JsonValue::NUMBER: value(v.number_val); break;
+        case JsonValue::BOOL: value(v.bool_val); break;
+        case JsonValue::STRING: value(v.string_val()); break;
+        case JsonValue::ARRAY:
+            beginArray();
+            for (size_t i = 0; i < v.len; i++) value(v.items[i]);
+            endArray();
+            break;
+        case JsonValue::OBJECT:
+            beginObject();
+            for (size_t i = 0; i < v.len; i++) {
+                key(v.members[i].name());
+                value(v.members[i].value);
+            }
+            endObject();
+            break;
+    }
+}
+
+inline std::string JsonValue::dump(int indent) const {
+    std::string s;
+    {
+        JsonWriter writer(s, indent);
+        writer.value(*this);
+    }
+    return s;
+}
+
+// Parses JSON straight out of a caller-owned buffer (a memory-mapped file
+// for parseFile) into the current JsonArena: strings are copied once into
+// the arena and numbers are converted in place with std::from_chars.
 class JsonParser {
-    std::string str;
+    std::string_view str;
     size_t pos;
+    std::vector<JsonValue> scratch;
 
     void skipWhitespace() {
-        while (pos < str.length() && isspace(str[pos])) pos++;
+        while (pos < str.length() && isspace((unsigned char)str[pos])) pos++;
     }
 
-    std::string parseString() {
-        std::string val;
+    std::string_view parseString() {
         pos++; // skip "
-        while (pos < str.length() && str[pos] != '"') {
-            val += str[pos++];
-        }
-        pos++; // skip closing "
-        return val;
+        size_t start = pos;
+        size_t end = str.find('"', start);
+        if (end == std::string_view::npos) end = str.length();
+        pos = end + 1; // skip closing "
+        return str.substr(start, end - start);
     }
 
     double parseNumber() {
         size_t start = pos;
-        while (pos < str.length() && (isdigit(str[pos]) || str[pos] == '.' || str[pos] == '-')) pos++;
-        return std::stod(str.substr(start, pos - start));
+        bool integral = true;
+        while (pos < str.length()) {
+            char c = str[pos];
+            if (isdigit((unsigned char)c) || c == '-') {
+                pos++;
+            } else if (c == '.' || c == 'e' || c == 'E' || c == '+') {
+                integral = false;
+                pos++;
+            } else {
+                break;
+            }
+        }
+        const char* first = str.data() + start;
+        const char* last = str.data() + pos;
+        if (integral) {
+            long long i = 0;
+            auto res = std::from_chars(first, last, i);
+            if (res.ec == std::errc() && res.ptr == last) return (double)i;
+        }
+        double d = 0;
+        std::from_chars(first, last, d);
+        return d;
     }
 
     bool parseBool() {
-        if (str.substr(pos, 4) == "true") { pos += 4; return true; }
-        if (str.substr(pos, 5) == "false") { pos += 5; return false; }
+        if (str.compare(pos, 4, "true") == 0) { pos += 4; return true; }
+        if (str.compare(pos, 5, "false") == 0) { pos += 5; return false; }
         return false;
     }
 
@@ -123,7 +559,7 @@ class JsonParser {
         if (c == '{') return parseObject();
         if (c == '[') return parseArray();
         if (c == '"') return JsonValue(parseString());
-        if (isdigit(c) || c == '-') return JsonValue(parseNumber());
+        if (isdigit((unsigned char)c) || c == '-') return JsonValue(parseNumber());
         if (c == 't' || c == 'f') return JsonValue(parseBool());
         
         pos++; // skip unknown
@@ -135,48 +571,58 @@ class JsonParser {
         pos++; // skip {
         while (true) {
             skipWhitespace();
+            if (pos >= str.length()) break;
             if (str[pos] == '}') { pos++; break; }
             
-            std::string key = parseString();
+            std::string_view key = parseString();
             skipWhitespace();
-            if (str[pos] == ':') pos++;
+            if (pos < str.length() && str[pos] == ':') pos++;
             
-            obj.object_val[key] = parseValue();
+            JsonValue value = parseValue();
+            obj[key] = value;
             
             skipWhitespace();
-            if (str[pos] == ',') pos++;
+            if (pos < str.length() && str[pos] == ',') pos++;
         }
         return obj;
     }
 
     JsonValue parseArray() {
-        JsonValue arr = JsonValue::array();
+        // Items collect on a shared scratch stack and are copied into the
+        // arena once the array's length is known
+        size_t base = scratch.size();
         pos++; // skip [
         while (true) {
             skipWhitespace();
+            if (pos >= str.length()) break;
             if (str[pos] == ']') { pos++; break; }
             
-            arr.push_back(parseValue());
+            JsonValue item = parseValue();
+            scratch.push_back(item);
             
             skipWhitespace();
-            if (str[pos] == ',') pos++;
+            if (pos < str.length() && str[pos] == ',') pos++;
         }
+        JsonValue arr = JsonValue::array();
+        arr.resize(scratch.size() - base);
+        std::copy(scratch.begin() + base, scratch.end(), arr.items);
+        scratch.resize(base);
         return arr;
     }
 
 public:
-    JsonValue parse(const std::string& input) {
+    // `input` must outlive the call; nothing is retained afterwards
+    JsonValue parse(std::string_view input) {
         str = input;
         pos = 0;
         return parseValue();
     }
     
     static JsonValue parseFile(const std::string& filename) {
-        std::ifstream f(filename);
-        std::stringstream buffer;
-        buffer << f.rdbuf();
+        MappedFile file(filename);
         JsonParser parser;
-        return parser.parse(buffer.str());
+        if (!file.is_open()) return parser.parse(std::string_view());
+        return parser.parse(file.view());
     }
 };
 
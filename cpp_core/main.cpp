@@ -1,97 +1,131 @@
 #include "json_utils.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
 
-#include "deadlock.h"
-#include "memory.h"
+#include "batch.h"
+#include "engine.h"
+#include "result_cache.h"
+#include "server.h"
+#include "thread_pool.h"
+#include "trace_events.h"
+
+// Writes the recorded spans when main returns, if --trace-events was given
+struct TraceEventExport {
+  std::string path;
+  ~TraceEventExport() {
+    if (!path.empty() && !TraceEvents::write(path))
+      std::cerr << "Error: cannot write trace events to " << path
+                << std::endl;
+  }
+};
 
 int main(int argc, char *argv[]) {
-  if (argc < 3) {
-    std::cerr << "Usage: " << argv[0] << " <input.json> <output.json>"
+  // --trace-events <file> and the cache options may accompany any of the
+  // modes below
+  std::vector<std::string> args;
+  TraceEventExport trace_export;
+  ResultCache::Options cache_options;
+  bool use_cache = true;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--trace-events" && i + 1 < argc) {
+      trace_export.path = argv[++i];
+      TraceEvents::enable();
+      TraceEvents::nameThread("main");
+    } else if (arg == "--cache-dir" && i + 1 < argc) {
+      cache_options.dir = argv[++i];
+    } else if (arg == "--cache-memory-mb" && i + 1 < argc) {
+      cache_options.memory_bytes = (size_t)std::max(0, std::atoi(argv[++i]))
+                                   << 20;
+    } else if (arg == "--cache-disk-mb" && i + 1 < argc) {
+      cache_options.disk_bytes =
+          (unsigned long long)std::max(0, std::atoi(argv[++i])) << 20;
+    } else if (arg == "--no-cache") {
+      use_cache = false;
+    } else {
+      args.push_back(argv[i]);
+    }
+  }
+  const size_t n = args.size();
+  std::unique_ptr<ResultCache> cache;
+  if (use_cache)
+    cache.reset(new ResultCache(cache_options));
+
+  if (n >= 2 && args[1] == "--serve") {
+    // Long-running mode: newline-delimited JSON requests and results
+    if (n >= 3)
+      return serveUnixSocket(args[2], cache.get());
+    return serveStream(stdin, stdout, cache.get());
+  }
+
+  if (n >= 4 && args[1] == "--batch") {
+    // Many independent jobs, one per line, run on a worker pool
+    size_t threads = ThreadPool::defaultThreads();
+    if (n >= 6 && args[4] == "--threads")
+      threads = (size_t)std::max(1, std::atoi(args[5].c_str()));
+    return runBatch(args[2], args[3], threads, cache.get());
+  }
+
+  if (n < 3) {
+    std::cerr << "Usage: " << args[0] << " <input.json> <output.json>\n"
+              << "       " << args[0] << " --serve [unix-socket-path]\n"
+              << "       " << args[0]
+              << " --batch <jobs.jsonl> <results.jsonl> [--threads N]\n"
+              << "Any mode also accepts --trace-events <trace.json>, "
+              << "--cache-dir <dir>, --cache-memory-mb N, --cache-disk-mb N "
+              << "and --no-cache."
               << std::endl;
     return 1;
   }
 
-  std::string input_file = argv[1];
-  std::string output_file = argv[2];
+  std::string input_file = args[1];
+  std::string output_file = args[2];
 
   try {
-    JsonValue input = JsonParser::parseFile(input_file);
-    std::string mode;
-    if (input["mode"].type == JsonValue::STRING) {
-      mode = input["mode"].string_val;
-    } else {
+    // Input and output documents share one arena, freed on exit from main
+    JsonArena arena;
+    JsonArena::Scope arena_scope(arena);
+
+    // Reading and parsing are timed here in case the input asks for metrics
+    Metrics timing;
+    AllocationStats::Scope allocation_scope(&timing.allocations);
+    Metrics::Clock::time_point t = Metrics::Clock::now();
+    MappedFile file(input_file);
+    t = timing.lap(Metrics::READ, t);
+    timing.bytes_read = file.view().size();
+    JsonValue input;
+    {
+      TraceSpan parse_span("parse", "json");
+      AllocationStats::Tag alloc_tag(AllocationStats::JSON);
+      JsonParser parser;
+      input = parser.parse(file.view());
+    }
+    timing.lap(Metrics::PARSE, t);
+    if (input["mode"].type != JsonValue::STRING) {
       std::cerr << "Error: 'mode' field missing or invalid in input JSON."
                 << std::endl;
       return 1;
     }
 
-    JsonValue output = JsonValue::object();
-
-    if (mode == "BANKER") {
-      JsonValue banker_data = input["banker"];
-      int p = (int)banker_data["processes"].number_val;
-      int r = (int)banker_data["resources"].number_val;
-
-      std::vector<int> avail;
-      for (size_t i = 0; i < banker_data["available"].array_val.size(); i++)
-        avail.push_back((int)banker_data["available"][i].number_val);
-
-      std::vector<std::vector<int>> max_mat;
-      for (size_t i = 0; i < banker_data["max"].array_val.size(); i++) {
-        std::vector<int> r_row;
-        for (size_t j = 0; j < banker_data["max"][i].array_val.size(); j++)
-          r_row.push_back((int)banker_data["max"][i][j].number_val);
-        max_mat.push_back(r_row);
-      }
-
-      std::vector<std::vector<int>> alloc_mat;
-      for (size_t i = 0; i < banker_data["allocation"].array_val.size(); i++) {
-        std::vector<int> r_row;
-        for (size_t j = 0; j < banker_data["allocation"][i].array_val.size();
-             j++)
-          r_row.push_back((int)banker_data["allocation"][i][j].number_val);
-        alloc_mat.push_back(r_row);
-      }
-
-      BankerAlgorithm banker(p, r, avail, max_mat, alloc_mat);
-      output = banker.solve();
-
-    } else if (mode == "DEADLOCK") {
-      DeadlockDetector detector;
-      JsonValue dd_data = input["deadlock"];
-      JsonValue edges = dd_data["edges"];
-
-      for (size_t i = 0; i < edges.array_val.size(); i++) {
-        std::string u = edges[i]["from"].string_val;
-        std::string v = edges[i]["to"].string_val;
-        detector.addEdge(u, v);
-      }
-      output = detector.detect();
-
-    } else if (mode == "MEMORY") {
-      JsonValue mem_data = input["memory"];
-      int frames = (int)mem_data["frames"].number_val;
-      std::string algo = mem_data["algorithm"].string_val;
-      std::vector<int> refs;
-
-      for (size_t i = 0; i < mem_data["references"].array_val.size(); i++) {
-        refs.push_back((int)mem_data["references"][i].number_val);
-      }
-
-      MemoryManager mgr(frames, refs, algo);
-      output = mgr.simulate();
-
-    } else {
-      output["error"] = "Unknown mode: " + mode;
+    std::FILE *out = std::fopen(output_file.c_str(), "w");
+    if (!out) {
+      std::cerr << "Error: cannot open output file " << output_file
+                << std::endl;
+      return 1;
     }
-
-    std::ofstream out(output_file);
-    out << output.dump(4); // 4 spaces indent
-    out.close();
+    JsonWriter writer(out, 4); // 4 spaces indent
+    // A single run only gains from results kept on disk
+    runRequest(input, writer, &timing,
+               cache_options.dir.empty() ? nullptr : cache.get());
+    writer.flush();
+    std::fclose(out);
 
   } catch (const std::exception &e) {
     std::cerr << "Error: " << e.what() << std::endl;
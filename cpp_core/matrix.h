@@ -0,0 +1,105 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Row-major integer matrix in a single allocation, each cell stored in 1, 2
+// or 4 bytes as chosen at construction. Rows are padded with zeros to a
+// multiple of ROW_BYTES and start on a 32-byte boundary, so vector kernels
+// can run over whole rows without a scalar tail or a split load.
+class PackedMatrix {
+public:
+  static const int ROW_BYTES = 32; // one 256-bit register
+
+  PackedMatrix() = default;
+  PackedMatrix(int rows, int cols, int cell_bytes)
+      : rows_(rows), cols_(cols), cell(cell_bytes),
+        row_bytes(paddedBytes(cols, cell_bytes)),
+        storage((size_t)rows * row_bytes + ROW_BYTES) {
+    align();
+  }
+  PackedMatrix(const PackedMatrix &other)
+      : rows_(other.rows_), cols_(other.cols_), cell(other.cell),
+        row_bytes(other.row_bytes), storage(other.storage.size()) {
+    align();
+    std::copy(other.begin(), other.begin() + (size_t)rows_ * row_bytes,
+              begin());
+  }
+  PackedMatrix &operator=(const PackedMatrix &other) {
+    if (this != &other) {
+      PackedMatrix copy(other);
+      *this = std::move(copy);
+    }
+    return *this;
+  }
+  PackedMatrix(PackedMatrix &&) = default;
+  PackedMatrix &operator=(PackedMatrix &&) = default;
+
+  // Bytes of a row of `cols` cells, rounded up to whole vectors
+  static int paddedBytes(int cols, int cell_bytes) {
+    return (cols * cell_bytes + ROW_BYTES - 1) / ROW_BYTES * ROW_BYTES;
+  }
+  // Smallest cell that holds every value in [lo, hi]
+  static int cellBytesFor(long long lo, long long hi) {
+    if (lo >= INT8_MIN && hi <= INT8_MAX)
+      return 1;
+    if (lo >= INT16_MIN && hi <= INT16_MAX)
+      return 2;
+    return 4;
+  }
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+  int cellBytes() const { return cell; }
+  int rowBytes() const { return row_bytes; }
+
+  void *row(int i) { return begin() + (size_t)i * row_bytes; }
+  const void *row(int i) const { return begin() + (size_t)i * row_bytes; }
+
+  int get(int i, int j) const {
+    const void *r = row(i);
+    switch (cell) {
+    case 1:
+      return static_cast<const int8_t *>(r)[j];
+    case 2:
+      return static_cast<const int16_t *>(r)[j];
+    default:
+      return static_cast<const int32_t *>(r)[j];
+    }
+  }
+  void set(int i, int j, int value) {
+    void *r = row(i);
+    switch (cell) {
+    case 1:
+      static_cast<int8_t *>(r)[j] = (int8_t)value;
+      break;
+    case 2:
+      static_cast<int16_t *>(r)[j] = (int16_t)value;
+      break;
+    default:
+      static_cast<int32_t *>(r)[j] = value;
+    }
+  }
+
+private:
+  int rows_ = 0;
+  int cols_ = 0;
+  int cell = 4;
+  int row_bytes = 0;
+  std::vector<unsigned char> storage; // ROW_BYTES extra leave room to align
+  size_t offset = 0; // of the first aligned byte in `storage`
+
+  unsigned char *begin() { return storage.data() + offset; }
+  const unsigned char *begin() const { return storage.data() + offset; }
+
+  void align() {
+    uintptr_t address = (uintptr_t)storage.data();
+    offset = (ROW_BYTES - address % ROW_BYTES) % ROW_BYTES;
+  }
+};
+
+#endif
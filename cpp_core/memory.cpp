@@ -1,13 +1,213 @@
 #include "memory.h"
+#include "metrics.h"
+#include "trace_events.h"
+#include <algorithm>
 #include <iostream>
+#include <unordered_map>
+
+namespace {
+
+// Open-addressing page -> frame slot map sized for the resident set, so
+// lookups, inserts and erases never allocate once a simulation is running.
+class PageTable {
+  std::vector<int> keys;
+  std::vector<int> slots; // -1 marks an empty bucket
+  size_t mask;
+  int shift; // 64 - log2(bucket count)
+  mutable long long probes = 0; // buckets examined by find()
+
+  // Fibonacci hashing: the top bits of the product depend on every bit of
+  // the page, so strided page numbers spread out instead of sharing their
+  // low bits
+  size_t home(int page) const {
+    return (size_t)(((uint64_t)(uint32_t)page * 0x9E3779B97F4A7C15ull) >>
+                    shift);
+  }
+
+public:
+  explicit PageTable(int capacity) {
+    size_t n = 16;
+    shift = 60;
+    while (n < 2 * (size_t)(capacity > 0 ? capacity : 0)) {
+      n *= 2;
+      shift--;
+    }
+    keys.assign(n, 0);
+    slots.assign(n, -1);
+    mask = n - 1;
+  }
+
+  int find(int page) const {
+    for (size_t i = home(page);; i = (i + 1) & mask) {
+      probes++;
+      if (slots[i] == -1)
+        return -1;
+      if (keys[i] == page)
+        return slots[i];
+    }
+  }
+
+  void insert(int page, int slot) {
+    size_t i = home(page);
+    while (slots[i] != -1 && keys[i] != page)
+      i = (i + 1) & mask;
+    keys[i] = page;
+    slots[i] = slot;
+  }
+
+  void erase(int page) {
+    size_t i = home(page);
+    while (slots[i] != -1 && keys[i] != page)
+      i = (i + 1) & mask;
+    if (slots[i] == -1)
+      return;
+    // Backward-shift deletion keeps probe chains intact without tombstones
+    slots[i] = -1;
+    for (size_t j = (i + 1) & mask; slots[j] != -1; j = (j + 1) & mask) {
+      size_t h = home(keys[j]);
+      bool movable = (j > i) ? (h <= i || h > j) : (h <= i && h > j);
+      if (movable) {
+        keys[i] = keys[j];
+        slots[i] = slots[j];
+        slots[j] = -1;
+        i = j;
+      }
+    }
+  }
+
+  long long probeCount() const { return probes; }
+};
+
+// Adds a run's work to the metrics counters of the running request, if any
+void countWork(const PageTable &slot_of, long long evictions) {
+  if (EngineCounters *counters = EngineCounters::active()) {
+    counters->frame_scans += slot_of.probeCount();
+    counters->evictions += evictions;
+  }
+}
+
+// Max-heap of frame slots keyed by (next use, -slot), with each slot's heap
+// position tracked so a key can be changed in place.
+class NextUseHeap {
+  std::vector<int> heap;     // slots
+  std::vector<int> where;    // slot -> index in heap
+  std::vector<int> next_use; // slot -> key
+
+  bool above(int a, int b) const { // a belongs above b
+    return next_use[a] != next_use[b] ? next_use[a] > next_use[b] : a < b;
+  }
+  void place(size_t i, int slot) {
+    heap[i] = slot;
+    where[slot] = (int)i;
+  }
+  void siftUp(size_t i) {
+    int slot = heap[i];
+    while (i > 0 && above(slot, heap[(i - 1) / 2])) {
+      place(i, heap[(i - 1) / 2]);
+      i = (i - 1) / 2;
+    }
+    place(i, slot);
+  }
+  void siftDown(size_t i) {
+    int slot = heap[i];
+    for (;;) {
+      size_t child = 2 * i + 1;
+      if (child >= heap.size())
+        break;
+      if (child + 1 < heap.size() && above(heap[child + 1], heap[child]))
+        child++;
+      if (!above(heap[child], slot))
+        break;
+      place(i, heap[child]);
+      i = child;
+    }
+    place(i, slot);
+  }
+
+public:
+  explicit NextUseHeap(int capacity) {
+    size_t n = capacity > 0 ? capacity : 0;
+    heap.reserve(n);
+    where.assign(n, -1);
+    next_use.assign(n, 0);
+  }
+
+  bool empty() const { return heap.empty(); }
+  int top() const { return heap[0]; }
+
+  void push(int slot, int key) {
+    next_use[slot] = key;
+    heap.push_back(slot);
+    siftUp(heap.size() - 1);
+  }
+
+  void update(int slot, int key) {
+    int old = next_use[slot];
+    next_use[slot] = key;
+    if (key > old)
+      siftUp(where[slot]);
+    else
+      siftDown(where[slot]);
+  }
+};
+
+// Frame slots a run can fill: no more than the frames, nor than the
+// references, however large `frames` is
+int slotCapacity(int frames, size_t references) {
+  return (int)std::min<size_t>(frames > 0 ? frames : 0, references);
+}
+
+} // namespace
 
 MemoryManager::MemoryManager(int frames, const std::vector<int> &refs,
-                             std::string algo)
-    : num_frames(frames), references(refs), algorithm(algo) {}
+                             std::string algo, const TraceOptions &trace)
+    : num_frames(frames), references(refs), algorithm(algo), trace(trace) {}
 
 JsonValue MemoryManager::simulate() {
   JsonValue result = JsonValue::object();
   JsonValue steps = JsonValue::array();
+  StepSink sink(steps, trace);
+
+  run(result, sink);
+
+  result["steps"] = steps;
+  return result;
+}
+
+void MemoryManager::simulate(JsonWriter &out) {
+  // Steps go out first, as they are produced; the totals follow
+  JsonValue result = JsonValue::object();
+  out.key("steps");
+  out.beginArray();
+  StepSink sink(out, trace);
+  run(result, sink);
+  out.endArray();
+  for (size_t i = 0; i < result.size(); i++) {
+    out.key(result.members[i].name());
+    out.value(result.members[i].value);
+  }
+}
+
+void MemoryManager::simulate(const StepColumns &columns, int &page_faults,
+                             int &hits) {
+  // Only the two totals land in the result object; keep them off the
+  // caller's arena
+  JsonArena arena;
+  JsonArena::Scope arena_scope(arena);
+  JsonValue result = JsonValue::object();
+  StepSink sink(columns);
+  run(result, sink);
+  page_faults = (int)result["page_faults"].number_val;
+  hits = (int)result["hits"].number_val;
+}
+
+void MemoryManager::run(JsonValue &result, StepSink &steps) {
+  if (trace.delta && trace.enabled()) {
+    // Lets readers size the frame list before the first keyframe
+    result["trace_format"] = "delta";
+    result["frames"] = num_frames;
+    result["keyframe_every"] = (double)trace.keyframe_every;
+  }
 
   if (algorithm == "FIFO") {
     runFIFO(result, steps);
@@ -18,186 +218,199 @@ JsonValue MemoryManager::simulate() {
   } else {
     result["error"] = "Unknown algorithm: " + algorithm;
   }
-
-  result["steps"] = steps;
-  return result;
 }
 
-void MemoryManager::runFIFO(JsonValue &result, JsonValue &steps) {
-  std::deque<int> frames;
+void MemoryManager::runFIFO(JsonValue &result, StepSink &steps) {
+  TraceSpan span("memory.FIFO", "memory");
+  TraceChunks chunks("steps", "memory");
+  // Frame slots used as a ring: `oldest` is the next slot to be replaced,
+  // and listing the ring from there gives arrival order.
+  const int capacity = slotCapacity(num_frames, references.size());
+  std::vector<int> frames;
+  frames.reserve(capacity);
+  PageTable slot_of(capacity);
+  size_t oldest = 0;
   int page_faults = 0;
   int hits = 0;
+  long long evictions = 0;
 
-  for (int page : references) {
-    JsonValue step = JsonValue::object();
-    step["page"] = page;
-
-    bool found = false;
-    for (int f : frames) {
-      if (f == page) {
-        found = true;
-        break;
-      }
-    }
+  for (size_t i = 0; i < references.size(); i++) {
+    chunks.at(i);
+    int page = references[i];
+    MemoryStep step = {i, page, false, -1, false, 0};
 
-    if (found) {
+    step.slot = slot_of.find(page);
+    if (step.slot != -1) {
       hits++;
-      step["status"] = "HIT";
+      step.hit = true;
     } else {
       page_faults++;
-      step["status"] = "MISS";
-      if (frames.size() < num_frames) {
-        frames.push_back(page);
-      } else {
-        frames.pop_front();
+      if ((int)frames.size() < num_frames) {
+        step.slot = (int)frames.size();
+        slot_of.insert(page, step.slot);
         frames.push_back(page);
+      } else if (!frames.empty()) {
+        step.slot = (int)oldest;
+        step.evicted = true;
+        evictions++;
+        step.victim = frames[oldest];
+        slot_of.erase(frames[oldest]);
+        frames[oldest] = page;
+        slot_of.insert(page, step.slot);
+        oldest = (oldest + 1) % frames.size();
       }
     }
 
-    JsonValue f_arr = JsonValue::array();
-    for (int f : frames)
-      f_arr.push_back(f);
-    step["frames"] = f_arr;
-    steps.push_back(step);
+    steps.add(step, frames, oldest);
   }
   result["page_faults"] = page_faults;
   result["hits"] = hits;
+  countWork(slot_of, evictions);
 }
 
-void MemoryManager::runLRU(JsonValue &result, JsonValue &steps) {
+void MemoryManager::runLRU(JsonValue &result, StepSink &steps) {
+  TraceSpan span("memory.LRU", "memory");
+  TraceChunks chunks("steps", "memory");
+  // Resident pages are kept on a doubly linked recency list threaded through
+  // their frame slots (head = most recent, tail = least recent) and indexed by
+  // page, so hit detection, promotion and eviction are all O(1).
+  const int capacity = slotCapacity(num_frames, references.size());
   std::vector<int> frames;
-  std::map<int, int> last_used; // page -> timestamp
-  int time = 0;
+  frames.reserve(capacity);
+  std::vector<int> prev(capacity, -1);
+  std::vector<int> next(capacity, -1);
+  PageTable slot_of(capacity);
+  int head = -1;
+  int tail = -1;
   int page_faults = 0;
   int hits = 0;
+  long long evictions = 0;
 
-  for (int page : references) {
-    time++;
-    JsonValue step = JsonValue::object();
-    step["page"] = page;
+  auto unlink = [&](int slot) {
+    if (prev[slot] != -1)
+      next[prev[slot]] = next[slot];
+    else
+      head = next[slot];
+    if (next[slot] != -1)
+      prev[next[slot]] = prev[slot];
+    else
+      tail = prev[slot];
+  };
+  auto push_front = [&](int slot) {
+    prev[slot] = -1;
+    next[slot] = head;
+    if (head != -1)
+      prev[head] = slot;
+    head = slot;
+    if (tail == -1)
+      tail = slot;
+  };
 
-    bool found = false;
-    for (int f : frames) {
-      if (f == page) {
-        found = true;
-        break;
-      }
-    }
+  for (size_t i = 0; i < references.size(); i++) {
+    chunks.at(i);
+    int page = references[i];
+    MemoryStep step = {i, page, false, -1, false, 0};
 
-    if (found) {
+    int slot = slot_of.find(page);
+    if (slot != -1) {
       hits++;
-      step["status"] = "HIT";
-      last_used[page] = time;
+      step.hit = true;
+      if (slot != head) {
+        unlink(slot);
+        push_front(slot);
+      }
     } else {
       page_faults++;
-      step["status"] = "MISS";
-      if (frames.size() < num_frames) {
+      if ((int)frames.size() < num_frames) {
+        slot = (int)frames.size();
         frames.push_back(page);
-      } else {
-        // Find LRU
-        int lru_page = -1;
-        int min_time = 2147483647;
-
-        for (int f : frames) {
-          if (last_used[f] < min_time) {
-            min_time = last_used[f];
-            lru_page = f;
-          }
-        }
-
-        // Replace
-        for (size_t i = 0; i < frames.size(); i++) {
-          if (frames[i] == lru_page) {
-            frames[i] = page;
-            break;
-          }
-        }
+        slot_of.insert(page, slot);
+        push_front(slot);
+      } else if (tail != -1) {
+        // Evict the least recently used page and reuse its slot
+        slot = tail;
+        step.evicted = true;
+        evictions++;
+        step.victim = frames[slot];
+        slot_of.erase(frames[slot]);
+        unlink(slot);
+        frames[slot] = page;
+        slot_of.insert(page, slot);
+        push_front(slot);
       }
-      last_used[page] = time;
     }
+    step.slot = slot;
 
-    JsonValue f_arr = JsonValue::array();
-    for (int f : frames)
-      f_arr.push_back(f);
-    step["frames"] = f_arr;
-    steps.push_back(step);
+    steps.add(step, frames);
   }
   result["page_faults"] = page_faults;
   result["hits"] = hits;
+  countWork(slot_of, evictions);
 }
 
-void MemoryManager::runOptimal(JsonValue &result, JsonValue &steps) {
+void MemoryManager::runOptimal(JsonValue &result, StepSink &steps) {
+  TraceSpan span("memory.OPTIMAL", "memory");
+  TraceChunks chunks("steps", "memory");
+  const int n = (int)references.size();
+
+  // next_use[i] is the position of the next reference to references[i]
+  // (n if it is never referenced again), filled in a single backward pass.
+  std::vector<int> next_use(n);
+  {
+    std::unordered_map<int, int> upcoming; // page -> nearest later position
+    for (int i = n - 1; i >= 0; i--) {
+      auto it = upcoming.find(references[i]);
+      next_use[i] = (it == upcoming.end()) ? n : it->second;
+      upcoming[references[i]] = i;
+    }
+  }
+
+  // Resident slots in a max-heap keyed by (next use, -slot). The top is the
+  // victim: the farthest next use, and among pages never used again the
+  // lowest slot.
+  const int capacity = slotCapacity(num_frames, references.size());
+  NextUseHeap by_next_use(capacity);
+  PageTable slot_of(capacity);
   std::vector<int> frames;
+  frames.reserve(capacity);
   int page_faults = 0;
   int hits = 0;
+  long long evictions = 0;
 
-  for (size_t i = 0; i < references.size(); i++) {
+  for (int i = 0; i < n; i++) {
+    chunks.at(i);
     int page = references[i];
-    JsonValue step = JsonValue::object();
-    step["page"] = page;
-
-    bool found = false;
-    for (int f : frames) {
-      if (f == page) {
-        found = true;
-        break;
-      }
-    }
+    MemoryStep step = {(size_t)i, page, false, -1, false, 0};
 
-    if (found) {
+    int slot = slot_of.find(page);
+    if (slot != -1) {
       hits++;
-      step["status"] = "HIT";
+      step.hit = true;
+      // This reference was the page's next use; advance it
+      by_next_use.update(slot, next_use[i]);
     } else {
       page_faults++;
-      step["status"] = "MISS";
-      if (frames.size() < num_frames) {
+      if ((int)frames.size() < num_frames) {
+        slot = (int)frames.size();
         frames.push_back(page);
-      } else {
-        // Find Optimal Replacement
-        int farthest_idx = -1;
-        int pg_to_replace = -1;
-        int replace_idx_in_frames = -1;
-
-        for (size_t f_idx = 0; f_idx < frames.size(); f_idx++) {
-          int fr = frames[f_idx];
-          int next_use = -1;
-          for (size_t k = i + 1; k < references.size(); k++) {
-            if (references[k] == fr) {
-              next_use = k;
-              break;
-            }
-          }
-
-          if (next_use == -1) {
-            // Not used again, best candidate
-            pg_to_replace = fr;
-            replace_idx_in_frames = f_idx;
-            break;
-          } else {
-            if (next_use > farthest_idx) {
-              farthest_idx = next_use;
-              pg_to_replace = fr;
-              replace_idx_in_frames = f_idx;
-            }
-          }
-        }
-
-        // If we didn't find one that is never used again (break didn't hit),
-        // replace the farthest If replace_idx_in_frames is still -1 (shouldn't
-        // happen if logic is correct), default 0
-        if (replace_idx_in_frames == -1)
-          replace_idx_in_frames = 0;
-
-        frames[replace_idx_in_frames] = page;
+        slot_of.insert(page, slot);
+        by_next_use.push(slot, next_use[i]);
+      } else if (!by_next_use.empty()) {
+        slot = by_next_use.top();
+        step.evicted = true;
+        evictions++;
+        step.victim = frames[slot];
+        slot_of.erase(frames[slot]);
+        frames[slot] = page;
+        slot_of.insert(page, slot);
+        by_next_use.update(slot, next_use[i]);
       }
     }
+    step.slot = slot;
 
-    JsonValue f_arr = JsonValue::array();
-    for (int f : frames)
-      f_arr.push_back(f);
-    step["frames"] = f_arr;
-    steps.push_back(step);
+    steps.add(step, frames);
   }
   result["page_faults"] = page_faults;
   result["hits"] = hits;
+  countWork(slot_of, evictions);
 }
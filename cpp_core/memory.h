@@ -2,27 +2,159 @@
 #define MEMORY_H
 
 #include "json_utils.h"
-#include <algorithm>
-#include <deque>
-#include <map>
+#include "trace.h"
 #include <string>
 #include <vector>
 
+// What one reference did to memory
+struct MemoryStep {
+  size_t index;    // position in the reference string
+  int page;
+  bool hit;
+  int slot;        // frame slot hit or written, -1 if none
+  bool evicted;    // a resident page was replaced
+  int victim;      // the replaced page, if evicted
+};
+
+// Caller-owned per-reference outputs, one entry per reference; any column
+// may be null. `victim` is -1 where nothing was evicted.
+struct StepColumns {
+  int *hit;
+  int *slot;
+  int *victim;
+};
+
+// Destination of a simulation's per-reference steps: appended to a JsonValue
+// array, streamed through a JsonWriter as they are produced, or stored in
+// plain columns. Steps the trace options leave out are dropped before
+// anything is built; columns always receive every step.
+class StepSink {
+private:
+  JsonValue *steps;
+  JsonWriter *writer;
+  StepColumns columns = {nullptr, nullptr, nullptr};
+  TraceOptions trace;
+  // Delta format: a keyframe is due after skipped steps changed the frames
+  bool keyframed = false;
+  bool skipped_change = false;
+  size_t last_keyframe = 0;
+
+  bool takeKeyframe(size_t index) {
+    if (!trace.delta)
+      return true;
+    if (keyframed && !skipped_change &&
+        index - last_keyframe < trace.keyframe_every)
+      return false;
+    keyframed = true;
+    skipped_change = false;
+    last_keyframe = index;
+    return true;
+  }
+
+public:
+  StepSink(JsonValue &steps, const TraceOptions &trace)
+      : steps(&steps), writer(nullptr), trace(trace) {}
+  StepSink(JsonWriter &writer, const TraceOptions &trace)
+      : steps(nullptr), writer(&writer), trace(trace) {}
+  explicit StepSink(const StepColumns &columns)
+      : steps(nullptr), writer(nullptr), columns(columns) {}
+
+  bool enabled() const { return trace.enabled(); }
+
+  // `frames` is listed starting at slot `first`, wrapping around; delta
+  // traces always list physical slot order so slot numbers line up
+  void add(const MemoryStep &step, const std::vector<int> &frames,
+           size_t first = 0) {
+    if (!steps && !writer) {
+      if (columns.hit)
+        columns.hit[step.index] = step.hit;
+      if (columns.slot)
+        columns.slot[step.index] = step.slot;
+      if (columns.victim)
+        columns.victim[step.index] = step.evicted ? step.victim : -1;
+      return;
+    }
+    if (!trace.keep(step.index, !step.hit)) {
+      if (!step.hit)
+        skipped_change = true;
+      return;
+    }
+    bool with_frames = takeKeyframe(step.index);
+    bool with_slot = trace.delta && step.slot != -1;
+    bool with_victim = trace.delta && step.evicted;
+    if (trace.delta)
+      first = 0;
+    size_t n = frames.size();
+
+    if (writer) {
+      writer->beginObject();
+      if (with_victim) {
+        writer->key("evicted");
+        writer->value(step.victim);
+      }
+      if (with_frames) {
+        writer->key("frames");
+        writer->beginArray();
+        for (size_t k = 0; k < n; k++)
+          writer->value(frames[(first + k) % n]);
+        writer->endArray();
+      }
+      if (trace.indexed()) {
+        writer->key("index");
+        writer->value((double)step.index);
+      }
+      writer->key("page");
+      writer->value(step.page);
+      if (with_slot) {
+        writer->key("slot");
+        writer->value(step.slot);
+      }
+      writer->key("status");
+      writer->value(step.hit ? "HIT" : "MISS");
+      writer->endObject();
+      return;
+    }
+    JsonValue out = JsonValue::object();
+    if (with_victim)
+      out["evicted"] = step.victim;
+    if (trace.indexed())
+      out["index"] = (double)step.index;
+    out["page"] = step.page;
+    if (with_slot)
+      out["slot"] = step.slot;
+    out["status"] = step.hit ? "HIT" : "MISS";
+    if (with_frames) {
+      JsonValue f_arr = JsonValue::array();
+      for (size_t k = 0; k < n; k++)
+        f_arr.push_back(frames[(first + k) % n]);
+      out["frames"] = f_arr;
+    }
+    steps->push_back(out);
+  }
+};
 
 class MemoryManager {
 private:
   int num_frames;
   std::vector<int> references;
   std::string algorithm; // FIFO, LRU, OPTIMAL
+  TraceOptions trace;
 
 public:
-  MemoryManager(int frames, const std::vector<int> &refs, std::string algo);
+  MemoryManager(int frames, const std::vector<int> &refs, std::string algo,
+                const TraceOptions &trace = TraceOptions());
   JsonValue simulate();
+  // Writes the same result's members through `out`, into an object the
+  // caller has opened, without holding the steps in memory
+  void simulate(JsonWriter &out);
+  // Fills `columns` and the totals without building any JSON steps
+  void simulate(const StepColumns &columns, int &page_faults, int &hits);
 
   // Algorithm helpers
-  void runFIFO(JsonValue &result, JsonValue &steps);
-  void runLRU(JsonValue &result, JsonValue &steps);
-  void runOptimal(JsonValue &result, JsonValue &steps);
+  void run(JsonValue &result, StepSink &steps);
+  void runFIFO(JsonValue &result, StepSink &steps);
+  void runLRU(JsonValue &result, StepSink &steps);
+  void runOptimal(JsonValue &result, StepSink &steps);
 };
 
 #endif
@@ -0,0 +1,204 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "alloc_tracker.h"
+#include "json_utils.h"
+#include "perf_counters.h"
+#include <chrono>
+#include <string>
+
+// Work done by the engines, added while a Scope is active. Engines count in
+// locals and add their totals once at the end of a run, so nothing is paid
+// per step when metrics are off.
+struct EngineCounters {
+  long long frame_scans = 0;     // page table slots probed (MEMORY)
+  long long evictions = 0;       // resident pages replaced (MEMORY)
+  long long dfs_visits = 0;      // nodes entered by the cycle search (DEADLOCK)
+  long long row_comparisons = 0; // need rows checked against work (BANKER)
+
+  // Counters of the request running on this thread, or null
+  static EngineCounters *&active() {
+    static thread_local EngineCounters *counters = nullptr;
+    return counters;
+  }
+
+  class Scope {
+    EngineCounters *saved;
+
+  public:
+    explicit Scope(EngineCounters *counters) : saved(active()) {
+      active() = counters;
+    }
+    ~Scope() { active() = saved; }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+};
+
+// The optional "metrics" object of a result, requested with "metrics": true
+// in the input: wall-clock time per phase, bytes in and out, heap use by
+// subsystem, and the engine counters. "metrics": {"hardware": true} adds CPU
+// counters per phase.
+struct Metrics {
+  enum Phase { READ, PARSE, BUILD, SIMULATE, SERIALIZE, WRITE, PHASES };
+  using Clock = std::chrono::steady_clock;
+
+  double seconds[PHASES] = {};
+  unsigned long long bytes_read = 0;
+  unsigned long long bytes_written = 0;
+  EngineCounters counters;
+  AllocationStats allocations;
+  long long peak_rss_bytes = 0; // of the whole process, at the end
+  bool hardware = false;        // CPU counters were requested
+  std::string hardware_reason; // why they are unavailable, if they are
+  bool hardware_multiplexed = false; // counts scaled up from a share of time
+  bool hardware_supported[HardwareCounts::EVENTS] = {};
+  HardwareCounts hardware_counts[PHASES];
+
+  // Adds the time since `start` to `phase`; returns now, to start the next
+  Clock::time_point lap(Phase phase, Clock::time_point start) {
+    Clock::time_point now = Clock::now();
+    seconds[phase] += std::chrono::duration<double>(now - start).count();
+    return now;
+  }
+
+  void write(JsonWriter &out) const {
+    static const char *const names[PHASES] = {"read",     "parse",
+                                              "build",    "simulate",
+                                              "serialize", "write"};
+    // Sorted key order, as everywhere else in the output
+    static const Phase sorted[PHASES] = {BUILD,     PARSE,    READ,
+                                         SERIALIZE, SIMULATE, WRITE};
+    out.beginObject();
+    writeAllocations(out);
+    out.key("bytes_read");
+    out.value((long long)bytes_read);
+    out.key("bytes_written");
+    out.value((long long)bytes_written);
+    out.key("counters");
+    out.beginObject();
+    out.key("dfs_visits");
+    out.value(counters.dfs_visits);
+    out.key("evictions");
+    out.value(counters.evictions);
+    out.key("frame_scans");
+    out.value(counters.frame_scans);
+    out.key("row_comparisons");
+    out.value(counters.row_comparisons);
+    out.endObject();
+    if (hardware)
+      writeHardware(out, names);
+    out.key("phases_ms");
+    out.beginObject();
+    for (Phase phase : sorted) {
+      out.key(names[phase]);
+      out.value(seconds[phase] * 1e3);
+    }
+    out.endObject();
+    out.endObject();
+  }
+
+private:
+  static void writeUsage(JsonWriter &out, const AllocationStats::Usage &u) {
+    out.key("allocations");
+    out.value(u.allocations);
+    out.key("bytes");
+    out.value(u.bytes);
+    out.key("peak_bytes");
+    out.value(u.peak_bytes);
+  }
+
+  void writeAllocations(JsonWriter &out) const {
+    static const char *const subsystems[AllocationStats::SUBSYSTEMS] = {
+        "banker", "deadlock", "generator", "json", "memory", "mrc", "other"};
+    out.key("allocations");
+    out.beginObject();
+    writeUsage(out, allocations.total);
+    out.key("peak_rss_bytes");
+    out.value(peak_rss_bytes);
+    out.key("subsystems");
+    out.beginObject();
+    for (int s = 0; s < AllocationStats::SUBSYSTEMS; s++) {
+      out.key(subsystems[s]);
+      out.beginObject();
+      writeUsage(out, allocations.usage[s]);
+      out.endObject();
+    }
+    out.endObject();
+    out.endObject();
+  }
+
+  void writeHardware(JsonWriter &out, const char *const names[]) const {
+    out.key("hardware");
+    out.beginObject();
+    out.key("available");
+    out.value(hardware_reason.empty());
+    if (!hardware_reason.empty()) {
+      out.key("reason");
+      out.value(hardware_reason);
+      out.endObject();
+      return;
+    }
+    out.key("multiplexed");
+    out.value(hardware_multiplexed);
+    // Read and parse happen before counters are opened
+    static const Phase sorted[] = {BUILD, SERIALIZE, SIMULATE, WRITE};
+    out.key("phases");
+    out.beginObject();
+    for (Phase phase : sorted) {
+      const uint64_t *v = hardware_counts[phase].value;
+      auto has = [this](HardwareCounts::Event e) {
+        return hardware_supported[e];
+      };
+      auto ratio = [](uint64_t a, uint64_t b) {
+        return b > 0 ? (double)a / (double)b : 0.0;
+      };
+      out.key(names[phase]);
+      out.beginObject();
+      if (has(HardwareCounts::BRANCHES) && has(HardwareCounts::BRANCH_MISSES)) {
+        out.key("branch_miss_rate");
+        out.value(ratio(v[HardwareCounts::BRANCH_MISSES],
+                        v[HardwareCounts::BRANCHES]));
+      }
+      if (has(HardwareCounts::BRANCH_MISSES)) {
+        out.key("branch_misses");
+        out.value((long long)v[HardwareCounts::BRANCH_MISSES]);
+      }
+      if (has(HardwareCounts::BRANCHES)) {
+        out.key("branches");
+        out.value((long long)v[HardwareCounts::BRANCHES]);
+      }
+      if (has(HardwareCounts::CACHE_REFERENCES) &&
+          has(HardwareCounts::CACHE_MISSES)) {
+        out.key("cache_miss_rate");
+        out.value(ratio(v[HardwareCounts::CACHE_MISSES],
+                        v[HardwareCounts::CACHE_REFERENCES]));
+      }
+      if (has(HardwareCounts::CACHE_MISSES)) {
+        out.key("cache_misses");
+        out.value((long long)v[HardwareCounts::CACHE_MISSES]);
+      }
+      if (has(HardwareCounts::CACHE_REFERENCES)) {
+        out.key("cache_references");
+        out.value((long long)v[HardwareCounts::CACHE_REFERENCES]);
+      }
+      out.key("cycles");
+      out.value((long long)v[HardwareCounts::CYCLES]);
+      if (has(HardwareCounts::INSTRUCTIONS)) {
+        out.key("instructions");
+        out.value((long long)v[HardwareCounts::INSTRUCTIONS]);
+        out.key("ipc");
+        out.value(ratio(v[HardwareCounts::INSTRUCTIONS],
+                        v[HardwareCounts::CYCLES]));
+      }
+      out.endObject();
+    }
+    out.endObject();
+    // Counters follow the request's thread only
+    out.key("scope");
+    out.value("calling thread");
+    out.endObject();
+  }
+};
+
+#endif
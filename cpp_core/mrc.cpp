@@ -0,0 +1,370 @@
+#include "mrc.h"
+#include "trace_events.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Levels per block of the OPT stack's block maximums
+const size_t OPT_BLOCK = 64;
+
+// Fenwick (binary indexed) tree of counts over reference positions.
+class FenwickTree {
+  std::vector<int> tree;
+
+public:
+  explicit FenwickTree(size_t n) : tree(n + 1, 0) {}
+
+  void add(size_t pos, int delta) {
+    for (size_t i = pos + 1; i < tree.size(); i += i & (~i + 1))
+      tree[i] += delta;
+  }
+
+  // Sum of counts at positions [0, pos)
+  long long prefix(size_t pos) const {
+    long long sum = 0;
+    for (size_t i = pos; i > 0; i -= i & (~i + 1))
+      sum += tree[i];
+    return sum;
+  }
+};
+
+} // namespace
+
+MissRatioCurve::MissRatioCurve(int max_frames, const std::vector<int> &refs,
+                               std::string algo)
+    : max_frames(max_frames), references(refs), algorithm(algo) {}
+
+JsonValue MissRatioCurve::compute() {
+  TraceSpan span("mrc.compute", "mrc");
+  JsonValue result = JsonValue::object();
+  if (max_frames < 1) {
+    result["error"] = "MRC requires frames >= 1";
+    return result;
+  }
+
+  std::vector<long long> distance_counts(max_frames + 1, 0);
+  long long beyond = 0;
+  if (algorithm == "LRU") {
+    lruDistances(distance_counts, beyond);
+  } else if (algorithm == "OPTIMAL") {
+    optimalDistances(distance_counts, beyond);
+  } else {
+    result["error"] = "MRC requires a stack algorithm (LRU or OPTIMAL), got: " +
+                      algorithm;
+    return result;
+  }
+
+  // Faults with k frames = references whose distance exceeds k
+  JsonValue faults_arr = JsonValue::array();
+  JsonValue ratio_arr = JsonValue::array();
+  long long faults = beyond;
+  for (int d = 1; d <= max_frames; d++)
+    faults += distance_counts[d];
+  double total = (double)references.size();
+  for (int k = 1; k <= max_frames; k++) {
+    faults -= distance_counts[k];
+    faults_arr.push_back((double)faults);
+    ratio_arr.push_back(total > 0 ? faults / total : 0.0);
+  }
+
+  result["algorithm"] = algorithm;
+  result["max_frames"] = max_frames;
+  result["references"] = (double)references.size();
+  result["page_faults"] = faults_arr;
+  result["miss_ratio"] = ratio_arr;
+  return result;
+}
+
+void MissRatioCurve::lruDistances(std::vector<long long> &distance_counts,
+                                  long long &beyond) {
+  // A 1 marks the most recent reference position of each distinct page, so
+  // the LRU stack distance of a re-reference is the number of marks after
+  // the page's previous position, plus one. O(n log n) overall.
+  FenwickTree marks(references.size());
+  std::unordered_map<int, size_t> last_pos;
+
+  for (size_t t = 0; t < references.size(); t++) {
+    int page = references[t];
+    auto it = last_pos.find(page);
+    if (it == last_pos.end()) {
+      beyond++; // cold miss
+      last_pos[page] = t;
+    } else {
+      long long distance = marks.prefix(t) - marks.prefix(it->second + 1) + 1;
+      if (distance <= max_frames)
+        distance_counts[distance]++;
+      else
+        beyond++;
+      marks.add(it->second, -1);
+      it->second = t;
+    }
+    marks.add(t, 1);
+  }
+}
+
+void MissRatioCurve::optimalDistances(std::vector<long long> &distance_counts,
+                                      long long &beyond) {
+  const size_t n = references.size();
+
+  // Priority of a resident page is the position of its next reference (n if
+  // never referenced again); sooner means higher priority. Pages are
+  // renumbered 0..m-1 in order of first reference.
+  std::vector<size_t> next_use(n);
+  std::vector<int> page_id(n);
+  size_t pages = 0;
+  {
+    std::unordered_map<int, size_t> upcoming;
+    for (size_t i = n; i-- > 0;) {
+      auto it = upcoming.find(references[i]);
+      next_use[i] = (it == upcoming.end()) ? n : it->second;
+      upcoming[references[i]] = i;
+    }
+    std::unordered_map<int, int> ids;
+    for (size_t i = 0; i < n; i++)
+      page_id[i] = ids.emplace(references[i], (int)ids.size()).first->second;
+    pages = ids.size();
+  }
+
+  // OPT stack truncated to max_frames levels; levels 1..k always hold the
+  // contents of an optimal k-frame memory, so deeper levels never matter.
+  const size_t NONE = (size_t)-1;
+  const size_t levels = std::min((size_t)max_frames, pages);
+  std::vector<int> stack; // page ids
+  std::vector<size_t> priority; // next use of stack[i]
+  std::vector<size_t> level_of(pages, NONE);
+  stack.reserve(levels);
+  priority.reserve(levels);
+  // Highest priority value in each block of OPT_BLOCK levels
+  std::vector<size_t> block_max((levels + OPT_BLOCK - 1) / OPT_BLOCK, 0);
+  std::vector<size_t> moved; // levels whose page moves down
+
+  for (size_t t = 0; t < n; t++) {
+    int page = page_id[t];
+    bool found = level_of[page] != NONE;
+    size_t depth = found ? level_of[page] : stack.size();
+
+    // Mattson's update: the referenced page goes on top, and each level
+    // down to its old depth keeps the higher-priority one of its old entry
+    // and the page carried down from above. The carried page only changes
+    // at levels with a lower priority than every level above them, so only
+    // those move: each one's page to the next such level, the last one's to
+    // the old depth. Blocks with no such level are skipped whole.
+    moved.clear();
+    if (depth > 0) {
+      size_t carry_priority = priority[0];
+      moved.push_back(0);
+      for (size_t i = 1; i < depth;) {
+        if (i % OPT_BLOCK == 0 && block_max[i / OPT_BLOCK] <= carry_priority) {
+          i += OPT_BLOCK;
+          continue;
+        }
+        if (priority[i] > carry_priority) {
+          carry_priority = priority[i];
+          moved.push_back(i);
+        }
+        i++;
+      }
+    }
+
+    if (found) {
+      distance_counts[depth + 1]++;
+    } else {
+      beyond++;
+      if (stack.size() < levels) {
+        stack.push_back(page);
+        priority.push_back(0);
+      } else {
+        // The page carried past the last level leaves the truncated stack
+        depth = moved.back();
+        moved.pop_back();
+        level_of[stack[depth]] = NONE;
+      }
+    }
+    for (size_t i = moved.size(); i-- > 0;) {
+      stack[depth] = stack[moved[i]];
+      priority[depth] = priority[moved[i]];
+      level_of[stack[depth]] = depth;
+      size_t &block = block_max[depth / OPT_BLOCK];
+      block = std::max(block, priority[depth]);
+      depth = moved[i];
+    }
+    stack[0] = page;
+    priority[0] = next_use[t];
+    level_of[page] = 0;
+
+    // Levels that took a moved page's place hold a lower priority than
+    // before, so their blocks' maximums are recomputed.
+    moved.push_back(0);
+    size_t last_block = NONE;
+    for (size_t level : moved) {
+      size_t block = level / OPT_BLOCK;
+      if (block == last_block)
+        continue;
+      last_block = block;
+      size_t begin = block * OPT_BLOCK;
+      size_t end = std::min(begin + OPT_BLOCK, stack.size());
+      block_max[block] = *std::max_element(priority.begin() + begin,
+                                           priority.begin() + end);
+    }
+  }
+}
+
+SampledMissRatioCurve::SampledMissRatioCurve(int max_frames, double rate,
+                                             size_t max_pages)
+    : max_frames(max_frames), requested_rate(rate), max_pages(max_pages),
+      marks(1024 + 1, 0), clock(0),
+      distance_weights(max_frames > 0 ? max_frames + 1 : 1, 0.0),
+      beyond_weight(0), sampled_weight(0), total_references(0),
+      sampled_references(0) {
+  if (rate >= 1.0)
+    threshold = HASH_SPACE;
+  else if (rate <= 0.0)
+    threshold = 1;
+  else
+    threshold = std::max<uint32_t>(1, (uint32_t)(rate * HASH_SPACE));
+}
+
+uint32_t SampledMissRatioCurve::hashPage(int page) {
+  // splitmix64 finalizer: spreads neighbouring page numbers uniformly
+  uint64_t z = (uint64_t)(uint32_t)page + 0x9E3779B97F4A7C15ull;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  z ^= z >> 31;
+  return (uint32_t)(z & (HASH_SPACE - 1));
+}
+
+void SampledMissRatioCurve::mark(size_t pos, int delta) {
+  for (size_t i = pos + 1; i < marks.size(); i += i & (~i + 1))
+    marks[i] += delta;
+}
+
+long long SampledMissRatioCurve::marksBefore(size_t pos) const {
+  long long sum = 0;
+  for (size_t i = pos; i > 0; i -= i & (~i + 1))
+    sum += marks[i];
+  return sum;
+}
+
+void SampledMissRatioCurve::compact() {
+  // Renumber tracked pages 0..k-1 in recency order and rebuild the tree at
+  // twice that size, so compaction is amortized O(log) per reference.
+  std::vector<std::pair<size_t, int>> order;
+  order.reserve(tracked.size());
+  for (const auto &kv : tracked)
+    order.push_back({kv.second.clock, kv.first});
+  std::sort(order.begin(), order.end());
+
+  marks.assign(std::max<size_t>(1024, 2 * order.size()) + 1, 0);
+  for (size_t i = 0; i < order.size(); i++) {
+    tracked[order[i].second].clock = i;
+    mark(i, 1);
+  }
+  clock = order.size();
+}
+
+void SampledMissRatioCurve::untrackLargestHash() {
+  auto largest = std::prev(by_hash.end());
+  auto it = tracked.find(largest->second);
+  mark(it->second.clock, -1);
+  tracked.erase(it);
+  threshold = largest->first;
+  by_hash.erase(largest);
+}
+
+void SampledMissRatioCurve::reference(int page) {
+  total_references++;
+  uint32_t hash = hashPage(page);
+  if (hash >= threshold)
+    return;
+
+  auto it = tracked.find(page);
+  if (it == tracked.end() && max_pages > 0 && tracked.size() >= max_pages) {
+    // Keep the sample within budget by lowering the threshold to the
+    // largest hash in play, dropping whichever page owns it.
+    if (by_hash.empty() || hash > by_hash.rbegin()->first) {
+      threshold = hash;
+      return;
+    }
+    untrackLargestHash();
+  }
+
+  sampled_references++;
+  double rate = (double)threshold / HASH_SPACE;
+  double weight = 1.0 / rate; // references this sample stands for
+  sampled_weight += weight;
+
+  if (clock + 1 >= marks.size())
+    compact();
+  it = tracked.find(page);
+
+  if (it == tracked.end()) {
+    beyond_weight += weight; // cold miss
+    tracked[page] = {hash, clock};
+    by_hash.insert({hash, page});
+  } else {
+    // Each other sampled page seen since stands for 1 / rate pages
+    long long others = marksBefore(clock) - marksBefore(it->second.clock + 1);
+    double distance = 1 + std::ceil(others / rate);
+    if (distance <= max_frames)
+      distance_weights[(size_t)distance] += weight;
+    else
+      beyond_weight += weight;
+    mark(it->second.clock, -1);
+    it->second.clock = clock;
+  }
+  mark(clock, 1);
+  clock++;
+}
+
+JsonValue SampledMissRatioCurve::compute() const {
+  TraceSpan span("mrc.sampled", "mrc");
+  JsonValue result = JsonValue::object();
+  if (max_frames < 1) {
+    result["error"] = "MRC requires frames >= 1";
+    return result;
+  }
+
+  // Miss ratios are taken over the sampled weight rather than the true
+  // reference count: a hot page landing in (or out of) the sample skews the
+  // total far more than it skews the shape of the distance histogram.
+  double total = (double)total_references;
+  double faults = beyond_weight;
+  for (int d = 1; d <= max_frames; d++)
+    faults += distance_weights[d];
+
+  JsonValue faults_arr = JsonValue::array();
+  JsonValue ratio_arr = JsonValue::array();
+  double worst_error = 0;
+  for (int k = 1; k <= max_frames; k++) {
+    faults -= distance_weights[k];
+    double ratio =
+        sampled_weight > 0 ? std::min(std::max(faults / sampled_weight, 0.0), 1.0)
+                           : 0.0;
+    faults_arr.push_back(std::round(ratio * total));
+    ratio_arr.push_back(ratio);
+    // Normal-approximation 95% half-width of a miss ratio estimated from
+    // the sampled references
+    if (sampled_references > 0)
+      worst_error = std::max(
+          worst_error,
+          1.96 * std::sqrt(ratio * (1 - ratio) / sampled_references));
+  }
+
+  JsonValue sampling = JsonValue::object();
+  sampling["requested_rate"] = requested_rate;
+  sampling["rate"] = (double)threshold / HASH_SPACE;
+  sampling["max_pages"] = (double)max_pages;
+  sampling["sampled_pages"] = (double)tracked.size();
+  sampling["sampled_references"] = (double)sampled_references;
+  sampling["error_bound"] = sampled_references > 0 ? worst_error : 1.0;
+  sampling["confidence"] = 0.95;
+
+  result["algorithm"] = "LRU";
+  result["max_frames"] = max_frames;
+  result["references"] = total;
+  result["page_faults"] = faults_arr;
+  result["miss_ratio"] = ratio_arr;
+  result["sampling"] = sampling;
+  return result;
+}
@@ -0,0 +1,85 @@
+#ifndef MRC_H
+#define MRC_H
+
+#include "json_utils.h"
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Miss-ratio curve for every frame count 1..max_frames, computed in a
+// single pass over the reference string using the stack property of LRU
+// and OPTIMAL (Mattson et al.): a reference hits in a cache of k frames iff
+// its stack distance is at most k.
+class MissRatioCurve {
+private:
+  int max_frames;
+  std::vector<int> references;
+  std::string algorithm; // LRU, OPTIMAL
+
+  // distance_counts[d] = number of references with stack distance d
+  // (1 <= d <= max_frames); deeper references and cold misses are counted
+  // in `beyond`.
+  void lruDistances(std::vector<long long> &distance_counts,
+                    long long &beyond);
+  void optimalDistances(std::vector<long long> &distance_counts,
+                        long long &beyond);
+
+public:
+  MissRatioCurve(int max_frames, const std::vector<int> &refs,
+                 std::string algo);
+  JsonValue compute();
+};
+
+// Approximate LRU miss-ratio curve for traces too large for an exact pass
+// (SHARDS, Waldspurger et al.). Pages are sampled spatially by hash, so a
+// sampled page is seen on every reference; stack distances measured among
+// sampled pages are scaled up by 1 / rate. References are fed one at a time
+// and memory is bounded by the number of sampled pages, capped at max_pages
+// by lowering the sampling rate adaptively (fixed-size SHARDS).
+class SampledMissRatioCurve {
+private:
+  static const uint32_t HASH_SPACE = 1u << 24;
+
+  int max_frames;
+  double requested_rate;
+  size_t max_pages; // 0 = no cap
+  uint32_t threshold; // page is sampled iff hash < threshold
+
+  struct Tracked {
+    uint32_t hash;
+    size_t clock; // position of its last sampled reference
+  };
+  std::unordered_map<int, Tracked> tracked;
+  std::set<std::pair<uint32_t, int>> by_hash; // for lowering the threshold
+
+  // Fenwick tree over sampled-reference clock positions; a 1 marks the most
+  // recent position of each tracked page. Positions are compacted when the
+  // clock reaches the tree size, keeping it O(tracked pages).
+  std::vector<int> marks;
+  size_t clock;
+
+  std::vector<double> distance_weights; // estimated references per distance
+  double beyond_weight; // cold misses and distances past max_frames
+  double sampled_weight;
+  unsigned long long total_references;
+  unsigned long long sampled_references;
+
+  static uint32_t hashPage(int page);
+  void mark(size_t pos, int delta);
+  long long marksBefore(size_t pos) const;
+  void compact();
+  void untrackLargestHash();
+
+public:
+  // Sampled pages kept when no cap is given
+  static const size_t DEFAULT_MAX_PAGES = 8192;
+
+  SampledMissRatioCurve(int max_frames, double rate,
+                        size_t max_pages = DEFAULT_MAX_PAGES);
+  void reference(int page);
+  JsonValue compute() const;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "os_core_api.h"
+#include <exception>
+#include <string>
+#include <vector>
+
+#include "banker.h"
+#include "deadlock.h"
+#include "memory.h"
+
+// No exception may cross the C boundary
+#define OS_CORE_GUARD(body)                                                    \
+  try {                                                                        \
+    body                                                                       \
+  } catch (const std::exception &) {                                           \
+    return OS_CORE_ERR_INTERNAL;                                               \
+  } catch (...) {                                                              \
+    return OS_CORE_ERR_INTERNAL;                                               \
+  }
+
+extern "C" {
+
+int os_core_abi_version(void) { return OS_CORE_ABI_VERSION; }
+
+int os_core_memory_simulate(const char *algorithm, int frames,
+                            const int *references, size_t count, int *hit,
+                            int *slot, int *victim, int *page_faults,
+                            int *hits) {
+  if (!algorithm || frames < 0 || (count > 0 && !references))
+    return OS_CORE_ERR_ARGUMENT;
+  std::string algo(algorithm);
+  if (algo != "FIFO" && algo != "LRU" && algo != "OPTIMAL")
+    return OS_CORE_ERR_ARGUMENT;
+
+  OS_CORE_GUARD({
+    std::vector<int> refs(references, references + count);
+    MemoryManager mgr(frames, refs, algo);
+    int faults = 0;
+    int hit_count = 0;
+    mgr.simulate(StepColumns{hit, slot, victim}, faults, hit_count);
+    if (page_faults)
+      *page_faults = faults;
+    if (hits)
+      *hits = hit_count;
+    return OS_CORE_OK;
+  })
+}
+
+int os_core_banker_solve(int processes, int resources, const int *available,
+                         const int *maximum, const int *allocation, int *safe,
+                         int *safe_sequence, int *sequence_length) {
+  if (processes < 0 || resources < 0 || !safe)
+    return OS_CORE_ERR_ARGUMENT;
+  if (resources > 0 && !available)
+    return OS_CORE_ERR_ARGUMENT;
+  if (processes > 0 && resources > 0 && (!maximum || !allocation))
+    return OS_CORE_ERR_ARGUMENT;
+
+  OS_CORE_GUARD({
+    std::vector<int> avail(available, available + resources);
+    std::vector<std::vector<int>> max_mat(processes);
+    std::vector<std::vector<int>> alloc_mat(processes);
+    for (int i = 0; i < processes; i++) {
+      const size_t row = (size_t)i * resources;
+      max_mat[i].assign(maximum + row, maximum + row + resources);
+      alloc_mat[i].assign(allocation + row, allocation + row + resources);
+    }
+
+    BankerAlgorithm banker(processes, resources, avail, max_mat, alloc_mat);
+    std::vector<int> sequence;
+    *safe = banker.safeSequence(sequence) ? 1 : 0;
+    if (safe_sequence)
+      for (size_t k = 0; k < sequence.size(); k++)
+        safe_sequence[k] = sequence[k];
+    if (sequence_length)
+      *sequence_length = (int)sequence.size();
+    return OS_CORE_OK;
+  })
+}
+
+int os_core_deadlock_detect(int nodes, const int *edges, size_t edge_count,
+                            int *deadlock, int *cycle, size_t cycle_capacity,
+                            size_t *cycle_length) {
+  if (nodes < 0 || !deadlock || (edge_count > 0 && !edges))
+    return OS_CORE_ERR_ARGUMENT;
+  for (size_t e = 0; e < 2 * edge_count; e++)
+    if (edges[e] < 0 || edges[e] >= nodes)
+      return OS_CORE_ERR_ARGUMENT;
+
+  OS_CORE_GUARD({
+    std::vector<std::vector<int>> adj(nodes);
+    for (size_t e = 0; e < edge_count; e++)
+      adj[edges[2 * e]].push_back(edges[2 * e + 1]);
+    std::vector<int> roots(nodes);
+    for (int i = 0; i < nodes; i++)
+      roots[i] = i;
+
+    std::vector<int> found;
+    *deadlock = DeadlockDetector::findCycle(adj, roots, found) ? 1 : 0;
+    if (cycle_length)
+      *cycle_length = found.size();
+    if (!found.empty()) {
+      if (!cycle || found.size() > cycle_capacity)
+        return cycle ? OS_CORE_ERR_BUFFER : OS_CORE_OK;
+      for (size_t k = 0; k < found.size(); k++)
+        cycle[k] = found[k];
+    }
+    return OS_CORE_OK;
+  })
+}
+
+} // extern "C"
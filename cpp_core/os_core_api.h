@@ -0,0 +1,75 @@
+#ifndef OS_CORE_API_H
+#define OS_CORE_API_H
+
+/*
+ * C interface to the simulation engines for in-process hosts (ctypes, cffi,
+ * other languages). Inputs are plain int arrays, matrices are row-major, and
+ * results go into buffers owned by the caller; nothing is parsed or
+ * serialized. Every function returns OS_CORE_OK or a negative error code.
+ */
+
+#include <stddef.h>
+
+#if defined(_WIN32)
+#if defined(OS_CORE_BUILD)
+#define OS_CORE_API __declspec(dllexport)
+#else
+#define OS_CORE_API __declspec(dllimport)
+#endif
+#else
+#define OS_CORE_API __attribute__((visibility("default")))
+#endif
+
+#define OS_CORE_ABI_VERSION 1
+
+#define OS_CORE_OK 0
+#define OS_CORE_ERR_ARGUMENT -1 /* null pointer, bad size or algorithm */
+#define OS_CORE_ERR_BUFFER -2   /* an output buffer is too small */
+#define OS_CORE_ERR_INTERNAL -3 /* allocation failure or other exception */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* OS_CORE_ABI_VERSION of the loaded library. */
+OS_CORE_API int os_core_abi_version(void);
+
+/*
+ * Page replacement ("FIFO", "LRU" or "OPTIMAL") of `count` references into
+ * `frames` frames. `hit`, `slot` and `victim` may each be NULL or hold
+ * `count` entries: 1/0 per reference, the frame slot used (-1 if none) and
+ * the evicted page (-1 if none). `page_faults` and `hits` may be NULL.
+ */
+OS_CORE_API int os_core_memory_simulate(const char *algorithm, int frames,
+                                        const int *references, size_t count,
+                                        int *hit, int *slot, int *victim,
+                                        int *page_faults, int *hits);
+
+/*
+ * Banker's safety check. `available` has `resources` entries; `maximum` and
+ * `allocation` are `processes` x `resources`. `*safe` is set to 1 or 0 and
+ * `safe_sequence` (`processes` entries, may be NULL) receives the order in
+ * which processes finish, `*sequence_length` of them (all if safe).
+ */
+OS_CORE_API int os_core_banker_solve(int processes, int resources,
+                                     const int *available, const int *maximum,
+                                     const int *allocation, int *safe,
+                                     int *safe_sequence, int *sequence_length);
+
+/*
+ * Cycle detection in a resource allocation graph over nodes 0..nodes-1.
+ * `edges` holds `edge_count` (from, to) pairs. `*deadlock` is set to 1 or 0;
+ * on a deadlock `cycle` receives the cycle's nodes with the first repeated at
+ * the end (at most nodes + 1 entries), `*cycle_length` of them. With a NULL
+ * `cycle` only the length is reported.
+ */
+OS_CORE_API int os_core_deadlock_detect(int nodes, const int *edges,
+                                        size_t edge_count, int *deadlock,
+                                        int *cycle, size_t cycle_capacity,
+                                        size_t *cycle_length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+struct EventConfig {
+  uint32_t type;
+  uint64_t config;
+};
+
+const EventConfig EVENT_CONFIGS[HardwareCounts::EVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+int openEvent(const EventConfig &event, int group) {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.disabled = group == -1; // the leader starts the whole group
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                     PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+} // namespace
+
+PerfCounters::PerfCounters() {
+  for (int &fd : fds)
+    fd = -1;
+  // Cycles lead the group; without them nothing is reported
+  fds[HardwareCounts::CYCLES] =
+      openEvent(EVENT_CONFIGS[HardwareCounts::CYCLES], -1);
+  if (fds[HardwareCounts::CYCLES] < 0) {
+    why = std::string("perf_event_open: ") + std::strerror(errno);
+    return;
+  }
+  open[HardwareCounts::CYCLES] = true;
+  for (int e = 0; e < HardwareCounts::EVENTS; e++) {
+    if (e == HardwareCounts::CYCLES)
+      continue;
+    fds[e] = openEvent(EVENT_CONFIGS[e], fds[HardwareCounts::CYCLES]);
+    open[e] = fds[e] >= 0;
+  }
+  for (int e = 0; e < HardwareCounts::EVENTS; e++)
+    if (open[e])
+      ioctl(fds[e], PERF_EVENT_IOC_ID, &ids[e]);
+  ioctl(fds[HardwareCounts::CYCLES], PERF_EVENT_IOC_RESET,
+        PERF_IOC_FLAG_GROUP);
+  ioctl(fds[HardwareCounts::CYCLES], PERF_EVENT_IOC_ENABLE,
+        PERF_IOC_FLAG_GROUP);
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : fds)
+    if (fd >= 0)
+      close(fd);
+}
+
+void PerfCounters::read(uint64_t now[HardwareCounts::EVENTS]) {
+  // PERF_FORMAT_GROUP | ID: nr, time_enabled, time_running, {value, id}...
+  uint64_t buf[3 + 2 * HardwareCounts::EVENTS];
+  ssize_t n = ::read(fds[HardwareCounts::CYCLES], buf, sizeof(buf));
+  for (int e = 0; e < HardwareCounts::EVENTS; e++)
+    now[e] = last[e];
+  if (n < (ssize_t)(3 * sizeof(uint64_t)))
+    return;
+  time_enabled = buf[1];
+  time_running = buf[2];
+  // Scale up if the group was multiplexed off the PMU part of the time
+  double scale = buf[2] > 0 ? (double)buf[1] / (double)buf[2] : 1.0;
+  for (uint64_t k = 0; k < buf[0] && k < (uint64_t)HardwareCounts::EVENTS;
+       k++) {
+    for (int e = 0; e < HardwareCounts::EVENTS; e++)
+      if (open[e] && ids[e] == buf[4 + 2 * k])
+        now[e] = (uint64_t)((double)buf[3 + 2 * k] * scale);
+  }
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+  for (int &fd : fds)
+    fd = -1;
+  why = "hardware counters are only supported on Linux";
+}
+
+PerfCounters::~PerfCounters() {}
+
+void PerfCounters::read(uint64_t now[HardwareCounts::EVENTS]) {
+  for (int e = 0; e < HardwareCounts::EVENTS; e++)
+    now[e] = last[e];
+}
+
+#endif
+
+void PerfCounters::lap(HardwareCounts &into) {
+  if (!available())
+    return;
+  uint64_t now[HardwareCounts::EVENTS];
+  read(now);
+  for (int e = 0; e < HardwareCounts::EVENTS; e++) {
+    if (now[e] > last[e])
+      into.value[e] += now[e] - last[e];
+    last[e] = now[e];
+  }
+}
@@ -0,0 +1,65 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+
+// Hardware event counts, one slot per event
+struct HardwareCounts {
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    CACHE_REFERENCES,
+    CACHE_MISSES,
+    BRANCHES,
+    BRANCH_MISSES,
+    EVENTS
+  };
+  uint64_t value[EVENTS] = {};
+};
+
+// CPU performance counters for the calling thread (user space only), read
+// through Linux perf_event_open as one group so every event covers the same
+// interval. Work done on other threads (the parallel Banker strategy's
+// workers) is not counted. Where counters cannot be opened (other platforms,
+// a restrictive perf_event_paranoid, virtual machines without a PMU) or the
+// group never got onto the PMU, available() is false and reason() says why;
+// events the CPU lacks are just left out. If the group shared the PMU with
+// other groups, counts are scaled up by time enabled / time running and
+// multiplexed() is true.
+class PerfCounters {
+private:
+  int fds[HardwareCounts::EVENTS];
+  bool open[HardwareCounts::EVENTS] = {};
+  uint64_t ids[HardwareCounts::EVENTS] = {}; // kernel ids, to match reads
+  uint64_t last[HardwareCounts::EVENTS] = {};
+  uint64_t time_enabled = 0, time_running = 0; // as of the last read
+  std::string why;
+
+  void read(uint64_t now[HardwareCounts::EVENTS]);
+
+public:
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  bool available() const {
+    return open[HardwareCounts::CYCLES] &&
+           !(time_enabled > 0 && time_running == 0);
+  }
+  std::string reason() const {
+    if (why.empty() && !available())
+      return "counters never ran on the PMU (time_running is 0)";
+    return why;
+  }
+  bool multiplexed() const {
+    return time_running > 0 && time_running < time_enabled;
+  }
+  bool supported(HardwareCounts::Event event) const { return open[event]; }
+
+  // Adds the counts since the previous lap (or since construction) to `into`
+  void lap(HardwareCounts &into);
+};
+
+#endif
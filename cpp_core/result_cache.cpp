@@ -0,0 +1,242 @@
+#include "result_cache.h"
+#include "mapped_file.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+uint64_t mix(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+// Two independent 64-bit lanes over 8-byte words. Not cryptographic, but
+// 128 bits keep accidental collisions between inputs out of reach.
+std::string hash128(std::string_view data) {
+  uint64_t a = 0x243f6a8885a308d3ull;
+  uint64_t b = 0x13198a2e03707344ull;
+  size_t i = 0;
+  for (; i + 8 <= data.size(); i += 8) {
+    uint64_t w;
+    std::memcpy(&w, data.data() + i, 8);
+    a = rotl((a ^ w) * 0x9e3779b97f4a7c15ull, 31);
+    b = rotl((b ^ w) * 0xc2b2ae3d27d4eb4full, 29);
+  }
+  uint64_t tail = 0;
+  std::memcpy(&tail, data.data() + i, data.size() - i);
+  a = mix(a ^ tail ^ data.size());
+  b = mix(b ^ rotl(tail, 32) ^ ~(uint64_t)data.size());
+  a = mix(a ^ b);
+  b = mix(b ^ a);
+
+  char hex[33];
+  std::snprintf(hex, sizeof(hex), "%016llx%016llx", (unsigned long long)a,
+                (unsigned long long)b);
+  return hex;
+}
+
+// Results depend on the engines that produced them, so keys include a hash
+// of the running executable: a rebuild that changes any translation unit
+// changes every key. Empty if the executable cannot be read.
+const std::string &buildStamp() {
+  static const std::string stamp = [] {
+#ifdef _WIN32
+    char path[MAX_PATH];
+    DWORD n = GetModuleFileNameA(nullptr, path, MAX_PATH);
+    MappedFile exe(n > 0 && n < MAX_PATH ? std::string(path, n)
+                                         : std::string());
+#elif defined(__linux__)
+    MappedFile exe("/proc/self/exe");
+#else
+    MappedFile exe("");
+#endif
+    return exe.is_open() ? "os_core " + hash128(exe.view()) : std::string();
+  }();
+  return stamp;
+}
+
+} // namespace
+
+ResultCache::ResultCache(const Options &options) : options(options) {
+  if (buildStamp().empty()) {
+    std::cerr << "Warning: cannot read the executable to tell builds apart; "
+                 "caching disabled"
+              << std::endl;
+    return;
+  }
+  if (this->options.dir.empty())
+    return;
+  std::error_code ec;
+  fs::create_directories(this->options.dir, ec);
+  if (!fs::is_directory(this->options.dir, ec)) {
+    std::cerr << "Warning: cannot use cache directory " << this->options.dir
+              << "; caching in memory only" << std::endl;
+    this->options.dir.clear();
+    return;
+  }
+  for (const fs::directory_entry &file :
+       fs::directory_iterator(this->options.dir, ec)) {
+    if (file.path().extension() == ".json")
+      disk_used += file.file_size(ec);
+  }
+}
+
+std::string ResultCache::keyOf(const JsonValue &input, int indent) {
+  const JsonValue &metrics = input["metrics"];
+  if (metrics.type == JsonValue::OBJECT ||
+      (metrics.type == JsonValue::BOOL && metrics.bool_val))
+    return std::string();
+  if (input["cache"].type == JsonValue::BOOL && !input["cache"].bool_val)
+    return std::string();
+  if (buildStamp().empty())
+    return std::string();
+
+  std::string canonical = buildStamp();
+  canonical += '\n';
+  canonical += std::to_string(indent);
+  canonical += '\n';
+  {
+    JsonWriter writer(canonical, -1);
+    writer.beginObject();
+    for (size_t i = 0; i < input.size(); i++) {
+      std::string_view name = input.members[i].name();
+      if (name == "cache" || name == "id" || name == "metrics")
+        continue;
+      writer.key(name);
+      writer.value(input.members[i].value);
+    }
+    writer.endObject();
+  }
+  return hash128(canonical);
+}
+
+size_t ResultCache::maxEntryBytes() const {
+  unsigned long long disk = options.dir.empty() ? 0 : options.disk_bytes;
+  return (size_t)std::max<unsigned long long>(options.memory_bytes, disk);
+}
+
+bool ResultCache::lookup(const std::string &key, std::string &bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+      entries.splice(entries.begin(), entries, it->second);
+      bytes = it->second->bytes;
+      return true;
+    }
+  }
+  if (options.dir.empty())
+    return false;
+
+  std::string path = pathOf(key);
+  std::FILE *file = std::fopen(path.c_str(), "rb");
+  if (!file)
+    return false;
+  bytes.clear();
+  char chunk[64 * 1024];
+  size_t n;
+  while ((n = std::fread(chunk, 1, sizeof(chunk), file)) > 0)
+    bytes.append(chunk, n);
+  bool ok = !std::ferror(file);
+  std::fclose(file);
+  if (!ok)
+    return false;
+  // Touched so that disk eviction sees it as recently used
+  std::error_code ec;
+  fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+  std::lock_guard<std::mutex> lock(mutex);
+  remember(key, bytes);
+  return true;
+}
+
+void ResultCache::store(const std::string &key, const std::string &bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    remember(key, bytes);
+  }
+  if (options.dir.empty() || bytes.size() > options.disk_bytes)
+    return;
+
+  // Written under a private name and renamed, so readers never see a
+  // partial file
+  std::string path = pathOf(key);
+  std::string temp = path + "." +
+                     std::to_string(std::hash<std::thread::id>()(
+                         std::this_thread::get_id())) +
+                     ".tmp";
+  std::FILE *file = std::fopen(temp.c_str(), "wb");
+  if (!file)
+    return;
+  bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  ok = std::fclose(file) == 0 && ok;
+  std::error_code ec;
+  if (ok)
+    fs::rename(temp, path, ec);
+  if (!ok || ec) {
+    fs::remove(temp, ec);
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  disk_used += bytes.size();
+  if (disk_used > options.disk_bytes)
+    trimDisk();
+}
+
+// Called with the mutex held
+void ResultCache::remember(const std::string &key, const std::string &bytes) {
+  if (index.count(key) || bytes.size() > options.memory_bytes)
+    return;
+  entries.push_front(Entry{key, bytes});
+  index[key] = entries.begin();
+  memory_used += bytes.size();
+  while (memory_used > options.memory_bytes) {
+    memory_used -= entries.back().bytes.size();
+    index.erase(entries.back().key);
+    entries.pop_back();
+  }
+}
+
+std::string ResultCache::pathOf(const std::string &key) const {
+  return (fs::path(options.dir) / (key + ".json")).string();
+}
+
+// Removes the least recently used files until the directory fits again;
+// sizes are re-read, as other processes may share the directory. Called with
+// the mutex held.
+void ResultCache::trimDisk() {
+  struct File {
+    fs::path path;
+    fs::file_time_type used;
+    unsigned long long size;
+  };
+  std::vector<File> files;
+  std::error_code ec;
+  disk_used = 0;
+  for (const fs::directory_entry &entry :
+       fs::directory_iterator(options.dir, ec)) {
+    if (entry.path().extension() != ".json")
+      continue;
+    File f{entry.path(), entry.last_write_time(ec), entry.file_size(ec)};
+    disk_used += f.size;
+    files.push_back(f);
+  }
+  std::sort(files.begin(), files.end(),
+            [](const File &x, const File &y) { return x.used < y.used; });
+  for (const File &f : files) {
+    if (disk_used <= options.disk_bytes)
+      break;
+    if (fs::remove(f.path, ec))
+      disk_used -= f.size;
+  }
+}
@@ -0,0 +1,59 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "json_utils.h"
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Serialized results of earlier requests, addressed by a hash of the
+// canonical input (compact, keys sorted, numbers in the writer's form), so
+// an identical request is answered with the stored bytes instead of being
+// parsed into an engine, simulated and dumped again. Recently used results
+// stay in memory; with a directory they are also kept on disk, one file per
+// key, and survive the process. Both levels evict least recently used
+// entries beyond their size limit. Safe to share between threads.
+class ResultCache {
+public:
+  struct Options {
+    size_t memory_bytes = size_t(64) << 20;
+    std::string dir; // empty: memory only
+    unsigned long long disk_bytes = 256ull << 20;
+  };
+
+  explicit ResultCache(const Options &options);
+  ResultCache(const ResultCache &) = delete;
+  ResultCache &operator=(const ResultCache &) = delete;
+
+  // Key for the result of `input` written with `indent` (see JsonWriter), or
+  // an empty string when the request must not be served from the cache:
+  // "cache": false in the input, or metrics, which describe a single run.
+  // Batch job "id"s are not part of the key.
+  static std::string keyOf(const JsonValue &input, int indent);
+
+  bool lookup(const std::string &key, std::string &bytes);
+  void store(const std::string &key, const std::string &bytes);
+
+  // Largest result worth copying while it is written
+  size_t maxEntryBytes() const;
+
+private:
+  struct Entry {
+    std::string key;
+    std::string bytes;
+  };
+
+  Options options;
+  std::mutex mutex;
+  std::list<Entry> entries; // most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> index;
+  size_t memory_used = 0;
+  unsigned long long disk_used = 0;
+
+  void remember(const std::string &key, const std::string &bytes);
+  std::string pathOf(const std::string &key) const;
+  void trimDisk();
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "server.h"
+#include "engine.h"
+#include "json_utils.h"
+#include "trace_events.h"
+#include <iostream>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+bool readLine(std::FILE *in, std::string &line) {
+  line.clear();
+  char chunk[4096];
+  while (std::fgets(chunk, sizeof(chunk), in)) {
+    size_t n = strlen(chunk);
+    if (n > 0 && chunk[n - 1] == '\n') {
+      line.append(chunk, n - 1);
+      if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+      return true;
+    }
+    line.append(chunk, n);
+  }
+  return !line.empty();
+}
+
+namespace {
+
+// Replaces `response` with a one-line error result
+void errorLine(std::string &response, const std::string &message) {
+  response.clear();
+  JsonValue error = JsonValue::object();
+  error["error"] = message;
+  JsonWriter writer(response, -1);
+  writer.value(error);
+  writer.endLine();
+}
+
+} // namespace
+
+int serveStream(std::FILE *in, std::FILE *out, ResultCache *cache) {
+  JsonArena arena;
+  JsonArena::Scope arena_scope(arena);
+  JsonParser parser;
+  std::string line;
+  // One request's reply, sent only once it is complete, so a request that
+  // fails part way leaves nothing half-written on the connection
+  std::string response;
+
+  while (readLine(in, line)) {
+    if (line.find_first_not_of(" \t") == std::string::npos)
+      continue;
+    response.clear();
+    try {
+      // Waiting for the line is not counted as reading
+      Metrics timing;
+      timing.bytes_read = line.size();
+      AllocationStats::Scope allocation_scope(&timing.allocations);
+      TraceSpan request_span("request", "server");
+      Metrics::Clock::time_point t = Metrics::Clock::now();
+      JsonValue input;
+      {
+        TraceSpan parse_span("parse", "json");
+        AllocationStats::Tag alloc_tag(AllocationStats::JSON);
+        input = parser.parse(line);
+      }
+      timing.lap(Metrics::PARSE, t);
+      JsonWriter writer(response, -1); // compact: one result per line
+      runRequest(input, writer, &timing, cache);
+      writer.endLine();
+    } catch (const std::exception &e) {
+      errorLine(response, e.what());
+    } catch (...) {
+      errorLine(response, "Unknown error while handling request");
+    }
+    arena.reset();
+    // The reader went away (EPIPE on a socket): stop serving it
+    if (std::fwrite(response.data(), 1, response.size(), out) !=
+            response.size() ||
+        std::fflush(out) != 0)
+      return 1;
+  }
+  return 0;
+}
+
+#ifndef _WIN32
+int serveUnixSocket(const std::string &path, ResultCache *cache) {
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    std::cerr << "Error: cannot create socket" << std::endl;
+    return 1;
+  }
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "Error: socket path too long: " << path << std::endl;
+    close(listener);
+    return 1;
+  }
+  memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+  unlink(path.c_str());
+  if (bind(listener, (sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listener, 16) != 0) {
+    std::cerr << "Error: cannot listen on " << path << std::endl;
+    close(listener);
+    return 1;
+  }
+  // A client that disconnects mid-reply must fail only its own write with
+  // EPIPE, not kill the server
+  signal(SIGPIPE, SIG_IGN);
+
+  for (;;) {
+    int conn = accept(listener, nullptr, nullptr);
+    if (conn < 0)
+      continue;
+    std::FILE *in = fdopen(conn, "r");
+    std::FILE *out = fdopen(dup(conn), "w");
+    if (in && out)
+      serveStream(in, out, cache);
+    if (in)
+      std::fclose(in);
+    else
+      close(conn);
+    if (out)
+      std::fclose(out);
+  }
+}
+#else
+int serveUnixSocket(const std::string &path, ResultCache *cache) {
+  std::cerr << "Error: Unix domain sockets are not supported on this platform"
+            << std::endl;
+  return 1;
+}
+#endif
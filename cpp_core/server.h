@@ -0,0 +1,24 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <cstdio>
+#include <string>
+
+class ResultCache;
+
+// Reads one line (without its terminator) into `line`, reusing its capacity.
+// Returns false at end of input.
+bool readLine(std::FILE *in, std::string &line);
+
+// Serves simulation requests until end of input: each line of `in` is one
+// JSON input document, and its result is written to `out` as one line of
+// compact JSON. The line buffer, parser scratch space, document arena and
+// output buffer are reused from one request to the next. Repeated requests
+// are answered from `cache`, if given. Returns 1 if writing to `out` fails.
+int serveStream(std::FILE *in, std::FILE *out, ResultCache *cache = nullptr);
+
+// Same protocol over a Unix domain socket listening at `path`; connections
+// are served one after another. Not available on Windows.
+int serveUnixSocket(const std::string &path, ResultCache *cache = nullptr);
+
+#endif
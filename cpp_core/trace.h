@@ -0,0 +1,65 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "json_utils.h"
+#include <string>
+
+// How much of a simulation's step-by-step trace to record. Read from the
+// optional top-level "trace" input field, either a level name or
+// {"level": ..., "every": N}:
+//   "full"    every step (default)
+//   "sampled" every Nth step
+//   "events"  only steps that change state (faults/evictions, process runs)
+//   "none"    no steps; totals only
+// Memory traces can also use {"format": "delta", "keyframe_every": K}: steps
+// then carry only the slot written and the page evicted, and the full frame
+// list is repeated every K steps (and whenever skipped steps changed it).
+struct TraceOptions {
+  enum Level { NONE, SAMPLED, EVENTS, FULL };
+  Level level = FULL;
+  size_t every = 1;
+  bool delta = false;
+  size_t keyframe_every = 256;
+
+  bool enabled() const { return level != NONE; }
+
+  // Whether step `index` is recorded; `event` marks a state-changing step
+  bool keep(size_t index, bool event) const {
+    switch (level) {
+    case NONE:
+      return false;
+    case SAMPLED:
+      return index % every == 0;
+    case EVENTS:
+      return event;
+    case FULL:
+      return true;
+    }
+    return true;
+  }
+
+  // Partial traces label each step with its position in the full one
+  bool indexed() const { return level != FULL; }
+
+  static TraceOptions fromJson(const JsonValue &v) {
+    TraceOptions opts;
+    JsonValue level = v.type == JsonValue::OBJECT ? v["level"] : v;
+    std::string_view name = level.string_val();
+    if (name == "none")
+      opts.level = NONE;
+    else if (name == "sampled")
+      opts.level = SAMPLED;
+    else if (name == "events")
+      opts.level = EVENTS;
+    if (v.type == JsonValue::OBJECT) {
+      if (v["every"].number_val >= 1)
+        opts.every = (size_t)v["every"].number_val;
+      opts.delta = v["format"].string_val() == "delta";
+      if (v["keyframe_every"].number_val >= 1)
+        opts.keyframe_every = (size_t)v["keyframe_every"].number_val;
+    }
+    return opts;
+  }
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "trace_events.h"
+#include "json_utils.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct Event {
+  const char *name;
+  const char *category;
+  const char *arg_name;
+  long long arg;
+  uint64_t start;
+  uint64_t end;
+};
+
+// One per thread that records anything; owned by the registry so spans
+// outlive worker threads until they are written
+struct ThreadBuffer {
+  int tid;
+  const char *name = nullptr;
+  std::vector<Event> events;
+};
+
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+std::chrono::steady_clock::time_point origin;
+
+ThreadBuffer &localBuffer() {
+  // Only a thread's first event takes the lock
+  static thread_local ThreadBuffer *buffer = nullptr;
+  if (!buffer) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+    buffer = registry.back().get();
+    buffer->tid = (int)registry.size();
+  }
+  return *buffer;
+}
+
+// Every buffer as one trace-event document; the caller holds registry_mutex
+void writeEvents(std::FILE *out) {
+  JsonWriter w(out, -1);
+  w.beginObject();
+  w.key("displayTimeUnit");
+  w.value("ms");
+  w.key("traceEvents");
+  w.beginArray();
+  for (const auto &buffer : registry) {
+    if (buffer->name) {
+      w.beginObject();
+      w.key("args");
+      w.beginObject();
+      w.key("name");
+      w.value(buffer->name);
+      w.endObject();
+      w.key("name");
+      w.value("thread_name");
+      w.key("ph");
+      w.value("M");
+      w.key("pid");
+      w.value(1);
+      w.key("tid");
+      w.value(buffer->tid);
+      w.endObject();
+    }
+    for (const Event &e : buffer->events) {
+      w.beginObject();
+      if (e.arg_name) {
+        w.key("args");
+        w.beginObject();
+        w.key(e.arg_name);
+        w.value(e.arg);
+        w.endObject();
+      }
+      w.key("cat");
+      w.value(e.category);
+      // Microseconds, as the format expects
+      w.key("dur");
+      w.value((double)(e.end - e.start) / 1e3);
+      w.key("name");
+      w.value(e.name);
+      w.key("ph");
+      w.value("X");
+      w.key("pid");
+      w.value(1);
+      w.key("tid");
+      w.value(buffer->tid);
+      w.key("ts");
+      w.value((double)e.start / 1e3);
+      w.endObject();
+    }
+  }
+  w.endArray();
+  w.endObject();
+  w.endLine();
+}
+
+} // namespace
+
+void TraceEvents::enable() {
+  origin = std::chrono::steady_clock::now();
+  on().store(true);
+}
+
+uint64_t TraceEvents::now() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - origin)
+      .count();
+}
+
+void TraceEvents::record(const char *name, const char *category,
+                         uint64_t start, uint64_t end, const char *arg_name,
+                         long long arg) {
+  localBuffer().events.push_back({name, category, arg_name, arg, start, end});
+}
+
+void TraceEvents::nameThread(const char *name) {
+  if (enabled())
+    localBuffer().name = name;
+}
+
+bool TraceEvents::write(const std::string &path) {
+  std::FILE *out = std::fopen(path.c_str(), "w");
+  if (!out)
+    return false;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  writeEvents(out);
+  std::fclose(out);
+  return true;
+}
@@ -0,0 +1,105 @@
+#ifndef TRACE_EVENTS_H
+#define TRACE_EVENTS_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Timeline of scoped spans, written as Chrome trace-event JSON (loadable in
+// chrome://tracing or Perfetto). Recording is off unless enable() is called;
+// each thread then appends to its own buffer without locking, and the
+// buffers are collected by write() once the work is done.
+class TraceEvents {
+public:
+  static bool enabled() { return on().load(std::memory_order_relaxed); }
+  static void enable();
+
+  // Nanoseconds since enable()
+  static uint64_t now();
+
+  // Adds a complete span to the calling thread's buffer. `name`, `category`
+  // and `arg_name` must be string literals (they are stored as pointers).
+  static void record(const char *name, const char *category, uint64_t start,
+                     uint64_t end, const char *arg_name = nullptr,
+                     long long arg = 0);
+
+  // Labels the calling thread in the viewer
+  static void nameThread(const char *name);
+
+  // Writes every recorded span to `path`; false if it cannot be opened
+  static bool write(const std::string &path);
+
+private:
+  static std::atomic<bool> &on() {
+    static std::atomic<bool> flag{false};
+    return flag;
+  }
+};
+
+// Records the enclosing scope as one span
+class TraceSpan {
+  const char *name;
+  const char *category;
+  const char *arg_name;
+  long long arg;
+  uint64_t start = 0;
+  bool active;
+
+public:
+  TraceSpan(const char *name, const char *category,
+            const char *arg_name = nullptr, long long arg = 0)
+      : name(name), category(category), arg_name(arg_name), arg(arg),
+        active(TraceEvents::enabled()) {
+    if (active)
+      start = TraceEvents::now();
+  }
+  ~TraceSpan() {
+    if (active)
+      TraceEvents::record(name, category, start, TraceEvents::now(), arg_name,
+                          arg);
+  }
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+};
+
+// Splits a long loop into one span per `every` iterations; call at(i) at
+// the top of iteration i. Costs one branch per iteration when disabled.
+class TraceChunks {
+  const char *name;
+  const char *category;
+  size_t every;
+  size_t first = 0; // first iteration of the open chunk
+  size_t next;      // iteration that starts the next chunk
+  uint64_t start = 0;
+  bool active;
+  bool started = false;
+
+  void roll(size_t i) {
+    uint64_t t = TraceEvents::now();
+    if (started)
+      TraceEvents::record(name, category, start, t, "first", (long long)first);
+    started = true;
+    first = i;
+    next = i + every;
+    start = t;
+  }
+
+public:
+  TraceChunks(const char *name, const char *category, size_t every = 65536)
+      : name(name), category(category), every(every > 0 ? every : 1),
+        next(0), active(TraceEvents::enabled()) {}
+  ~TraceChunks() {
+    if (active && started)
+      TraceEvents::record(name, category, start, TraceEvents::now(), "first",
+                          (long long)first);
+  }
+  TraceChunks(const TraceChunks &) = delete;
+  TraceChunks &operator=(const TraceChunks &) = delete;
+
+  void at(size_t i) {
+    if (active && i >= next)
+      roll(i);
+  }
+};
+
+#endif
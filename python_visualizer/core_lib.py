@@ -0,0 +1,95 @@
+"""In-process access to the C++ engines through the os_core shared library.
+
+Inputs and outputs are `array('i')` buffers handed straight to the C ABI in
+os_core_api.h, so nothing is written to disk or converted to JSON.
+"""
+import ctypes
+import os
+import sys
+from array import array
+
+OS_CORE_ABI_VERSION = 1
+_ERRORS = {-1: "invalid argument", -2: "output buffer too small", -3: "internal error"}
+
+
+def _default_path():
+    core_dir = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "cpp_core")
+    if sys.platform == "win32":
+        return os.path.join(core_dir, "os_core.dll")
+    if sys.platform == "darwin":
+        return os.path.join(core_dir, "libos_core.dylib")
+    return os.path.join(core_dir, "libos_core.so")
+
+
+def _ints(values):
+    """An array('i') with the values, and a ctypes pointer into it."""
+    buf = values if isinstance(values, array) and values.typecode == "i" else array("i", values)
+    if len(buf) == 0:
+        return buf, None
+    return buf, (ctypes.c_int * len(buf)).from_buffer(buf)
+
+
+class CoreLibrary:
+    def __init__(self, path=None):
+        self.lib = ctypes.CDLL(path or _default_path())
+        c_int_p = ctypes.POINTER(ctypes.c_int)
+        c_size_p = ctypes.POINTER(ctypes.c_size_t)
+
+        self.lib.os_core_abi_version.restype = ctypes.c_int
+        self.lib.os_core_abi_version.argtypes = []
+        self.lib.os_core_memory_simulate.restype = ctypes.c_int
+        self.lib.os_core_memory_simulate.argtypes = [
+            ctypes.c_char_p, ctypes.c_int, c_int_p, ctypes.c_size_t,
+            c_int_p, c_int_p, c_int_p, c_int_p, c_int_p]
+        self.lib.os_core_banker_solve.restype = ctypes.c_int
+        self.lib.os_core_banker_solve.argtypes = [
+            ctypes.c_int, ctypes.c_int, c_int_p, c_int_p, c_int_p, c_int_p, c_int_p, c_int_p]
+        self.lib.os_core_deadlock_detect.restype = ctypes.c_int
+        self.lib.os_core_deadlock_detect.argtypes = [
+            ctypes.c_int, c_int_p, ctypes.c_size_t, c_int_p, c_int_p, ctypes.c_size_t, c_size_p]
+
+        version = self.lib.os_core_abi_version()
+        if version != OS_CORE_ABI_VERSION:
+            raise RuntimeError(f"os_core ABI version {version}, expected {OS_CORE_ABI_VERSION}")
+
+    @staticmethod
+    def _check(status):
+        if status != 0:
+            raise RuntimeError(f"os_core: {_ERRORS.get(status, status)}")
+
+    def memory_simulate(self, algorithm, frames, references):
+        """Returns (page_faults, hits, hit, slot, victim); the last three are
+        per-reference array('i') columns (victim is -1 where nothing was evicted)."""
+        refs, refs_p = _ints(references)
+        hit, hit_p = _ints(array("i", [0]) * len(refs))
+        slot, slot_p = _ints(array("i", [0]) * len(refs))
+        victim, victim_p = _ints(array("i", [0]) * len(refs))
+        faults, hits = ctypes.c_int(), ctypes.c_int()
+        self._check(self.lib.os_core_memory_simulate(
+            algorithm.encode(), frames, refs_p, len(refs), hit_p, slot_p, victim_p,
+            ctypes.byref(faults), ctypes.byref(hits)))
+        return faults.value, hits.value, hit, slot, victim
+
+    def banker_solve(self, available, maximum, allocation):
+        """Returns (safe, sequence) for row-lists `maximum` and `allocation`."""
+        processes, resources = len(maximum), len(available)
+        avail, avail_p = _ints(available)
+        max_flat, max_p = _ints([x for row in maximum for x in row])
+        alloc_flat, alloc_p = _ints([x for row in allocation for x in row])
+        seq, seq_p = _ints(array("i", [0]) * processes)
+        safe, length = ctypes.c_int(), ctypes.c_int()
+        self._check(self.lib.os_core_banker_solve(
+            processes, resources, avail_p, max_p, alloc_p,
+            ctypes.byref(safe), seq_p, ctypes.byref(length)))
+        return bool(safe.value), list(seq[:length.value])
+
+    def deadlock_detect(self, nodes, edges):
+        """Returns the cycle (first node repeated at the end) or [] for `nodes`
+        nodes and (from, to) edge pairs."""
+        flat, flat_p = _ints([x for edge in edges for x in edge])
+        cycle, cycle_p = _ints(array("i", [0]) * (nodes + 1))
+        deadlock, length = ctypes.c_int(), ctypes.c_size_t()
+        self._check(self.lib.os_core_deadlock_detect(
+            nodes, flat_p, len(edges), ctypes.byref(deadlock), cycle_p, len(cycle),
+            ctypes.byref(length)))
+        return list(cycle[:length.value]) if deadlock.value else []
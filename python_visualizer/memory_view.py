@@ -3,6 +3,24 @@ from tkinter import ttk, messagebox
 import json
 import os
 
+def expand_delta_steps(data):
+    """Rebuild the full frame list of every step of a delta-encoded trace.
+
+    Delta steps carry the frames only on keyframes; in between, a miss
+    records the slot it loaded the page into.
+    """
+    frames = []
+    steps = []
+    for step in data.get("steps", []):
+        if "frames" in step:
+            frames = list(step["frames"])
+        elif step.get("status") == "MISS" and "slot" in step:
+            slot = step["slot"]
+            frames.extend([-1] * (slot + 1 - len(frames)))
+            frames[slot] = step["page"]
+        steps.append(dict(step, frames=list(frames)))
+    return steps
+
 class MemoryView:
     def __init__(self, json_path):
         self.root = tk.Toplevel()
@@ -16,7 +34,10 @@ class MemoryView:
         with open(json_path, 'r') as f:
             self.data = json.load(f)
             
-        self.steps = self.data.get("steps", [])
+        if self.data.get("trace_format") == "delta":
+            self.steps = expand_delta_steps(self.data)
+        else:
+            self.steps = self.data.get("steps", [])
         self.current_step = 0
         self.page_faults = self.data.get("page_faults", 0)
         self.hits = self.data.get("hits", 0)
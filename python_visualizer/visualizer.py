@@ -10,6 +10,32 @@ import sys
 # from rag_view import show_rag_view
 # from memory_view import show_memory_view
 
+class CoreSession:
+    """A long-running `os_core --serve` process.
+
+    Requests and results are exchanged as one JSON document per line, so the
+    core is started once instead of once per simulation.
+    """
+    def __init__(self, exe):
+        self.exe = exe
+        self.proc = None
+
+    def request(self, data):
+        if self.proc is None or self.proc.poll() is not None:
+            self.proc = subprocess.Popen([self.exe, "--serve"], stdin=subprocess.PIPE,
+                                         stdout=subprocess.PIPE, text=True, bufsize=1)
+        self.proc.stdin.write(json.dumps(data) + "\n")
+        self.proc.stdin.flush()
+        line = self.proc.stdout.readline()
+        if not line:
+            raise RuntimeError("C++ core exited unexpectedly")
+        return json.loads(line)
+
+    def close(self):
+        if self.proc is not None and self.proc.poll() is None:
+            self.proc.stdin.close()
+            self.proc.wait()
+
 class OSSimulatorApp:
     def __init__(self, root):
         self.root = root
@@ -23,6 +49,7 @@ class OSSimulatorApp:
         self.data_dir = os.path.join(self.root_dir, "data")
         self.input_file = os.path.join(self.data_dir, "input.json")
         self.output_file = os.path.join(self.data_dir, "output.json")
+        self.core = CoreSession(self.cpp_exe)
         
         self.create_widgets()
 
@@ -46,7 +73,7 @@ class OSSimulatorApp:
         lbl_status.pack(side=tk.BOTTOM, pady=10)
         self.status_label = lbl_status
 
-    def run_core(self):
+    def run_core(self, data):
         self.status_label.config(text="Running C++ Core...", fg="orange")
         self.root.update()
         
@@ -56,11 +83,15 @@ class OSSimulatorApp:
             return False
 
         try:
-            result = subprocess.run([self.cpp_exe, self.input_file, self.output_file], capture_output=True, text=True)
-            if result.returncode != 0:
-                messagebox.showerror("Core Error", f"C++ Core failed:\n{result.stderr}")
+            result = self.core.request(data)
+            if "error" in result:
+                messagebox.showerror("Core Error", f"C++ Core failed:\n{result['error']}")
                 self.status_label.config(text="Error in C++ Core", fg="red")
                 return False
+
+            # The views read their data from the output file
+            with open(self.output_file, 'w') as f:
+                json.dump(result, f, indent=4)
             
             self.status_label.config(text="Simulation Complete.", fg="green")
             return True
@@ -110,7 +141,7 @@ class OSSimulatorApp:
             with open(self.input_file, 'w') as f:
                 json.dump(data, f, indent=4)
                 
-            if self.run_core():
+            if self.run_core(data):
                 # Load output and visualize
                 # show_banker_view(self.output_file)
                 import banker_view
@@ -137,7 +168,7 @@ class OSSimulatorApp:
             with open(self.input_file, 'w') as f:
                 json.dump(data, f, indent=4)
                 
-            if self.run_core():
+            if self.run_core(data):
                 import rag_view
                 rag_view.show_view(self.output_file)
                 win.destroy()
@@ -160,7 +191,7 @@ class OSSimulatorApp:
             with open(self.input_file, 'w') as f:
                 json.dump(data, f, indent=4)
             
-            if self.run_core():
+            if self.run_core(data):
                 import memory_view
                 memory_view.show_view(self.output_file)
                 win.destroy()
@@ -175,3 +206,4 @@ if __name__ == "__main__":
     root = tk.Tk()
     app = OSSimulatorApp(root)
     root.mainloop()
+    app.core.close()